@@ -2,9 +2,18 @@
 #define DASHSRV_MGCLIENT_H__
 
 #include <cstdint>
+#include <deque>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <mongoose.h>
+
+struct MGRequest {
+    std::string URL;
+    std::unordered_map<std::string, std::string> Headers; // sent in addition to the defaults
+};
+
 struct MGResponse {
     std::string URL;
 
@@ -15,12 +24,63 @@ struct MGResponse {
     bool Done = false;
 
     std::string Reason;
+
+    uint64_t ElapsedMS = 0; // time from the request being issued until it completed
+
+    int Status = 0;
+    std::unordered_map<std::string, std::string> Headers; // names are lowercased
+
+    std::string GetHeader(const std::string &name) const;
 };
 
 namespace Dashcli {
 
+struct PendingRequest;
+struct PooledConnection;
+
+// Persistent HTTP/1.1 client. Connections are pooled per host and kept alive between calls, requests to a busy host are
+// pipelined onto its open connections, and connections left idle for longer than the idle timeout are closed. Not
+// thread safe, use ThreadClient() to get one per thread.
+class Client {
+  public:
+    Client();
+    ~Client();
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    MGResponse get(const std::string &url, uint64_t timeoutMS = 3000);
+    std::vector<MGResponse> getAll(const std::vector<std::string> &urls, uint64_t timeoutMS = 3000);
+    std::vector<MGResponse> getAll(const std::vector<MGRequest> &requests, uint64_t timeoutMS = 3000);
+
+    void setIdleTimeout(uint64_t ms) { mIdleTimeoutMS = ms; }
+
+  private:
+    mg_mgr mMgr;
+    std::unordered_map<std::string, std::vector<PooledConnection *>> mPools;
+
+    uint64_t mIdleTimeoutMS = 30000;
+    size_t mMaxConnectionsPerHost = 4;
+    size_t mMaxPipelineDepth = 8;
+
+    void dispatch(PendingRequest *req);
+    PooledConnection *acquire(const std::string &url);
+    void evictIdle();
+
+    void onResponse(PooledConnection *pc, struct mg_http_message *hm);
+    void onClose(PooledConnection *pc, const std::string &reason);
+
+    friend void pool_ev_handler(mg_connection *c, int ev, void *ev_data);
+};
+
+Client &ThreadClient();
+
 MGResponse Get(std::string url);
 
-}
+// Issues every request at once, sharing one deadline. Results are in the same order as urls.
+std::vector<MGResponse> GetAll(const std::vector<std::string> &urls, uint64_t timeoutMS = 3000);
+std::vector<MGResponse> GetAll(const std::vector<MGRequest> &requests, uint64_t timeoutMS = 3000);
+
+} // namespace Dashcli
 
 #endif // DASHSRV_MGCLIENT_H__
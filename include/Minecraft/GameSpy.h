@@ -0,0 +1,87 @@
+#ifndef DASHSRV_GAMESPY_H__
+#define DASHSRV_GAMESPY_H__
+
+#include "MCDef.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Query protocol (GameSpy4 over UDP), every packet starts with the magic and a type
+#define GS_MAGIC 0xFEFD
+#define GS_PACKET_HANDSHAKE 0x09 // challenge token request and response
+#define GS_PACKET_STAT 0x00 // basic and full stat request and response
+
+// The Query protocol only allows these bits to be set in a session id
+#define GS_SESSION_MASK 0x0F0F0F0F
+
+struct mg_connection;
+struct mg_mgr;
+
+namespace Minecraft {
+
+    // Polls servers that have enable-query=true over UDP. A full stat has no TCP handshake and no favicon and lists
+    // every player by name, where the Server List Ping only sends a sample of them. There's no protocol version or
+    // icon in it, those are left empty.
+    //
+    // Challenge tokens are bound to the address they were issued to, so every server keeps its socket across polls and
+    // its token is reused until the server stops answering to it, which makes a poll one round trip most of the time.
+    class GameSpyClient {
+      public:
+        GameSpyClient();
+        ~GameSpyClient();
+
+        GameSpyClient(const GameSpyClient &) = delete;
+        GameSpyClient &operator=(const GameSpyClient &) = delete;
+
+        // Polls all servers at once (Port being the query port, ProtocolVersion unused), the statuses come back in the
+        // order of servers. Only one thread may poll a client at a time.
+        std::vector<MCStatus> QueryServers(const std::vector<MCServer> &servers, uint64_t timeoutMS = 3000);
+
+        // Unanswered requests are sent again after this long, a full stat sent with a reused token is retried with a
+        // new token instead.
+        static constexpr uint64_t RetryMS = 750;
+
+      private:
+        enum class Stage { Idle, Connecting, Challenge, Stat, Done };
+
+        struct Session {
+            struct mg_connection *Conn = nullptr;
+            int32_t Token = 0;
+            bool HasToken = false;
+
+            // the poll in progress
+            Stage Current = Stage::Idle;
+            uint32_t SessionID = 0;
+            uint64_t SentMS = 0;
+            bool Retried = false;
+            MCStatus Status;
+        };
+
+        struct mg_mgr *mgr;
+        std::map<std::string, Session> sessions; // by ip:port
+        uint32_t nextSessionID = 1;
+
+        void send(Session &session, uint64_t now);
+        void finish(Session &session, const std::string &error);
+
+        friend void gamespy_ev_handler(struct mg_connection *c, int ev, void *ev_data);
+    };
+
+    // Parses a full stat response (type, session id, the key/value section and the player list) without checking the
+    // session id. PingMS is left at 0.
+    MCStatus ParseFullStatResponse(const uint8_t *data, size_t len);
+
+    namespace inte__ {
+        std::vector<uint8_t> BuildQueryHandshakePacket(uint32_t sessionID);
+        std::vector<uint8_t> BuildFullStatRequestPacket(uint32_t sessionID, int32_t token);
+
+        // Reads the token out of a handshake response, false if it isn't one for sessionID.
+        bool ParseQueryChallenge(const uint8_t *data, size_t len, uint32_t sessionID, int32_t &token);
+    }
+
+}
+
+#endif // DASHSRV_GAMESPY_H__
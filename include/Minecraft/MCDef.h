@@ -2,6 +2,7 @@
 #define DASHSRV_MCDEF_H__
 
 #include <string>
+#include <vector>
 #include <cstdint>
 
 namespace Minecraft {
@@ -16,9 +17,11 @@ namespace Minecraft {
         struct {
             int Online;
             int Max;
+            std::vector<std::string> Names; // a sample from the Server List Ping, everyone from a query
         } Players;
 
-        std::string MOTD;
+        std::string MOTD;     // plain text
+        std::string MOTDHtml; // escaped, colors and styles as classes (see FormatChatComponent)
         std::string Icon;
 
         struct {
@@ -2,6 +2,7 @@
 #define DASHSRV_MCPACKET_H__
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 // Handshake information
@@ -83,6 +84,29 @@ namespace Minecraft {
         int32_t ReadVarInt(uint8_t *&data);
         int64_t ReadVarLong(uint8_t *&data);
 
+        // Bounds checked ReadVarInt for data that may still be arriving. Returns the number of bytes used, 0 if the
+        // varint isn't complete yet and -1 if it runs past 5 bytes.
+        int TryReadVarInt(const uint8_t *data, size_t len, int32_t &value);
+
+        // Cuts a stream into packets as it arrives. Reads can end anywhere, even in the middle of a length prefix.
+        class PacketFramer {
+          public:
+            void Feed(const uint8_t *data, size_t len);
+
+            // Takes the next complete packet (id and payload, without the length prefix), false if there's none yet.
+            bool Next(std::vector<uint8_t> &packet);
+
+            // Set once a length prefix was invalid, nothing after it can be framed.
+            bool Malformed() const { return malformed; }
+
+            static constexpr int32_t MaxPacketSize = 2097151; // largest length a 3 byte prefix can hold
+
+          private:
+            std::vector<uint8_t> buffer;
+            size_t offset = 0; // start of the first packet that wasn't taken yet
+            bool malformed = false;
+        };
+
         void WriteShort(std::vector<uint8_t> &data, int16_t val);
         void WriteInt(std::vector<uint8_t> &data, int32_t val);
         void WriteLong(std::vector<uint8_t> &data, int64_t val);
@@ -2,6 +2,7 @@
 #define DASHSRV_MCQUERY_H__
 
 #include "MCDef.h"
+#include "MCPacket.h"
 
 #include <vector>
 #include <functional>
@@ -14,12 +15,22 @@ namespace Minecraft {
         const MCServer *Server;
         std::function<void(MCSendBytes)> OnConnect;
 
-        std::vector<uint8_t> Recv;
+        // Gets every packet the moment it's complete (id and payload, no length prefix). Returning true ends the query
+        // successfully and closes the connection, without waiting for the server to do it.
+        std::function<bool(std::vector<uint8_t> &packet)> OnPacket;
+
+        packetool::PacketFramer Framer;
+        uint64_t LastRecvMS = 0; // when the last bytes came in, the pong ends the exchange so this times the ping
         bool Done = false;
         bool Success = false;
     };
 
-    void QueryMinecraft(MCQueryState &state, const MCServer &server, std::function<void(MCSendBytes)> onConnect);
+    void QueryMinecraft(MCQueryState &state, const MCServer &server, std::function<void(MCSendBytes)> onConnect,
+                        std::function<bool(std::vector<uint8_t> &packet)> onPacket);
+
+    // Runs every query (Server, OnConnect and OnPacket set) on one mg_mgr, so they all wait on the network at the same
+    // time and the batch takes as long as its slowest server. Queries still running after timeoutMS are given up on.
+    void QueryMinecraftAll(const std::vector<MCQueryState *> &states, uint64_t timeoutMS = 3000);
 }
 
 #endif // DASHSRV_MCQUERY_H__
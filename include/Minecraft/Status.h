@@ -3,9 +3,34 @@
 
 #include "MCDef.h"
 
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
 namespace Minecraft {
 
     MCStatus QueryServer(const MCServer &server);
+
+    // Queries all servers at once over one event loop, the statuses come back in the order of servers.
+    std::vector<MCStatus> QueryServers(const std::vector<MCServer> &servers);
+
+    // Parses what the server sent back to the handshake, status request and ping (as collected by QueryServer). The
+    // ping is measured up to receivedAtMS, or up to now if that's 0.
+    MCStatus ParseStatusResponse(std::vector<uint8_t> &recv, uint64_t receivedAtMS = 0);
+
+    // The same from the two packets on their own (id and payload, without the length prefix), as the query frames them.
+    MCStatus ParseStatusPackets(const std::vector<uint8_t> &statusPacket, const std::vector<uint8_t> &pongPacket,
+                                uint64_t receivedAtMS = 0);
+
+    // Turns a status favicon ("data:image/png;base64,...") into the PNG it holds, false if it isn't one.
+    bool DecodeFavicon(std::string_view favicon, std::string &png);
+
+    namespace inte__ {
+        std::vector<uint8_t> BuildHandshakePacket(const MCServer &server);
+        std::vector<uint8_t> BuildStatusRequestPacket();
+        std::vector<uint8_t> BuildPingRequestPacket();
+    }
     
 }
 
@@ -1,10 +1,27 @@
 #ifndef DASHSRV_MC_STRING_H__
 #define DASHSRV_MC_STRING_H__
 
+#include <nlohmann/json.hpp>
+
 #include <string>
+#include <string_view>
 
 namespace Minecraft {
 
+    enum class TextFormat {
+        Ansi,  // escape sequences for a terminal, hex colors as 24 bit color
+        Html,  // escaped text in <span>s with mc-c0..mc-cf and mc-l/mc-o/mc-n/mc-m/mc-k classes, no inline styles
+        Plain, // the text alone
+    };
+
+    // Renders text with legacy § formatting codes. A color code resets the styles, like it does in game.
+    std::string FormatText(std::string_view input, TextFormat format);
+
+    // Renders a chat component, the form most servers send their description in: a string, an array of components
+    // or an object with text, color, bold, italic, underlined, strikethrough, obfuscated and extra. § codes inside
+    // the text are applied as well.
+    std::string FormatChatComponent(const nlohmann::json &component, TextFormat format);
+
     std::string EscapeToAnsi(const std::string &input);
 
 }
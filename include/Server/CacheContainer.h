@@ -2,37 +2,135 @@
 #define DASHSRV_CACHECONTAINER_H__
 
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
 
 #include <Basic.h>
+#include <Server/Core/AssetCache.h>
+#include <Server/Core/Metrics.h>
+#include <Server/Core/Server.h>
 
-template<typename Store, uint64_t CacheTimerMS>
+// Holds the latest snapshot of a probed value. Written by the probe scheduler, read by request handlers, so every
+// access goes through the mutex and readers only ever get a shared, immutable copy. With a serializer set, the response
+// body is built once per refresh and stored next to the value, so handlers never serialize anything themselves.
+//
+// The serializer is also run with a timing of 0 to get the value without anything that changes on every refresh, its
+// hash is the snapshot's ETag. A refresh that found the same data keeps the ETag, so clients revalidate with a 304.
+// The response headers that go with the body are formatted along with it, a cache hit only adds its Age.
+template<typename Store>
 class CacheContainer {
- public:
-    CacheContainer() {
+  public:
+    using Serializer = std::function<std::string(const Store &, uint64_t)>;
+
+    struct Snapshot {
+        std::shared_ptr<const Store> value;
+        std::shared_ptr<const std::string> body; // null without a serializer
+        std::shared_ptr<const CachedHeaders> headers; // null without a serializer
+        uint64_t timing;
+    };
+
+    // A named container shows up in /metrics with its hit and miss counts.
+    explicit CacheContainer(uint64_t cacheTimerMS = 5000, const std::string &name = "")
+        : cacheTimerMS(cacheTimerMS), stored(std::make_shared<const Store>()) {
         lastFetchedTimeMS = 0;
+        if (!name.empty())
+            Metrics::get().addCache(name, &stats);
     }
-    
-    bool NeedsFetch() {
-        return GetTimeMillis() - lastFetchedTimeMS > CacheTimerMS;
+
+    void SetCacheTimer(uint64_t ms) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cacheTimerMS = ms;
     }
 
-    const Store &Cache(const Store &storing) {
-        stored = storing;
-        lastFetchedTimeMS = GetTimeMillis();
-        return stored;
+    uint64_t GetCacheTimer() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cacheTimerMS;
+    }
+
+    bool NeedsFetch() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return GetTimeMillis() - lastFetchedTimeMS > cacheTimerMS;
+    }
+
+    // Also serializes the value that is currently stored.
+    void SetSerializer(Serializer fn, const std::string &type = "application/json") {
+        std::lock_guard<std::mutex> lock(mutex);
+        serializer = std::move(fn);
+        contentType = type;
+        body = serializer ? std::make_shared<const std::string>(serializer(*stored, lastFetchedTimeMS)) : nullptr;
+        headers = serializer ? makeHeaders(serializer, type, *stored, lastFetchedTimeMS) : nullptr;
+    }
+
+    void Cache(Store storing) {
+        auto ptr = std::make_shared<const Store>(std::move(storing));
+        uint64_t timing = GetTimeMillis();
+
+        Serializer fn;
+        std::string type;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fn = serializer;
+            type = contentType;
+        }
+
+        // serialized outside the lock, readers keep getting the previous snapshot meanwhile
+        std::shared_ptr<const std::string> serialized;
+        std::shared_ptr<const CachedHeaders> formatted;
+        if (fn) {
+            serialized = std::make_shared<const std::string>(fn(*ptr, timing));
+            formatted = makeHeaders(fn, type, *ptr, timing);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stored = std::move(ptr);
+        body = std::move(serialized);
+        headers = std::move(formatted);
+        lastFetchedTimeMS = timing;
+    }
+
+    Snapshot GetSnapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return { stored, body, headers, lastFetchedTimeMS };
     }
 
-    const Store &Get() {
+    // GetSnapshot for reads made on behalf of a client, counted as a hit unless nothing was probed yet or the probe is
+    // more than a full timer period overdue.
+    Snapshot Lookup() const {
+        Snapshot snapshot = GetSnapshot();
+
+        uint64_t timer = GetCacheTimer();
+        bool fresh = snapshot.timing != 0 && GetTimeMillis() - snapshot.timing <= timer * 2;
+        (fresh ? stats.hits : stats.misses).fetch_add(1, std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    std::shared_ptr<const Store> Get() const {
+        std::lock_guard<std::mutex> lock(mutex);
         return stored;
     }
 
-    uint64_t GetTiming() {
+    uint64_t GetTiming() const {
+        std::lock_guard<std::mutex> lock(mutex);
         return lastFetchedTimeMS;
     }
 
   private:
+    mutable std::mutex mutex;
+    uint64_t cacheTimerMS;
     uint64_t lastFetchedTimeMS;
-    Store stored;
+    std::shared_ptr<const Store> stored;
+    std::shared_ptr<const std::string> body;
+    std::shared_ptr<const CachedHeaders> headers;
+    Serializer serializer;
+    std::string contentType;
+    mutable CacheStats stats;
+
+    static std::shared_ptr<const CachedHeaders> makeHeaders(const Serializer &fn, const std::string &type,
+                                                            const Store &value, uint64_t timing) {
+        return makeCachedHeaders(type, timing != 0 ? computeETag(fn(value, 0)) : "", timing);
+    }
 };
 
 #endif // DASHSRV_CACHECONTAINER_H__
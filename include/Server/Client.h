@@ -1,9 +1,15 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 struct UserClient {
     std::string id;
     std::string name;
-    bool isAdmin;
+    bool isAdmin = false;
+
+    std::unordered_set<std::string> topics = {};          // websocket topics the client subscribed to
+    std::unordered_map<std::string, uint32_t> acked = {}; // last version of each topic the client confirmed
 };
@@ -1,16 +1,20 @@
 #ifndef DASHSRV_SERVER_CONFIG_H__
 #define DASHSRV_SERVER_CONFIG_H__
 
+#include <cstdint>
 #include <string>
 #include <variant>
 #include <vector>
 
 struct DashsrvConfigServer {
     struct Minecraft {
+        std::string name; // unique, served at /api/mc/{name}
         std::string ip;
         int port;
         int version;
         std::string extraDomain;
+        bool query;    // polled with the UDP query protocol instead of the Server List Ping
+        int queryPort; // query.port from server.properties
     };
 
     struct Jellyfin {
@@ -23,14 +27,33 @@ struct DashsrvConfigServer {
         int port;
     };
 
+    // both the "tcp" and the "http" type, a tcp check only connects
+    struct Check {
+        std::string name; // unique among the checks
+        std::string ip;
+        int port;
+        std::string path;       // http only
+        int expectStatus;       // http only, 0 accepts anything below 400
+        std::string expectBody; // http only
+        uint64_t timeout;       // ms
+    };
+
     std::string type;
-    std::variant<Minecraft, Jellyfin, Dashboard> server;
+    std::variant<Minecraft, Jellyfin, Dashboard, Check> server;
+
+    uint64_t ttl = 0; // refresh interval in ms, 0 uses the service default
 };
 
 class DashsrvConfig {
   public:
     std::string ip;
     int port;
+    int workers = 1;
+
+    uint64_t localTTL = 5000;
+    uint64_t meshTTL = 5000;
+
+    uint64_t stallBudget = 50; // ms an event handler or poll iteration may take before it's reported, 0 disables
 
     std::vector<DashsrvConfigServer> servers;
 
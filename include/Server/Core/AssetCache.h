@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct StaticAsset {
+    std::string path;
+    std::shared_ptr<const std::string> body; // null for streamed assets
+    uint64_t size = 0;
+    std::string content_type;
+    std::string etag;
+    std::string last_modified;
+    std::filesystem::file_time_type mtime;
+
+    // gzip variant, compressed once when the asset is loaded. Null for binary formats or when it wouldn't be smaller.
+    std::shared_ptr<const std::string> gzip_body;
+    std::string gzip_etag;
+
+    // Files over the stream threshold aren't kept in memory, the server reads them from disk in chunks as the socket
+    // drains instead.
+    bool streamed = false;
+};
+
+// Keeps static files in memory so serving them doesn't touch the filesystem. On Linux entries are invalidated through
+// inotify, elsewhere their mtime is rechecked at most once a second. Large files only have their metadata cached.
+class AssetCache {
+  public:
+    ~AssetCache();
+
+    static AssetCache &get() {
+        static AssetCache cache;
+        return cache;
+    }
+
+    AssetCache(const AssetCache &) = delete;
+    AssetCache &operator=(const AssetCache &) = delete;
+
+    void preload(const std::string &root);
+
+    // Returns nullptr if filepath isn't a regular file.
+    std::shared_ptr<const StaticAsset> find(const std::string &filepath);
+
+  private:
+    AssetCache();
+
+    std::shared_mutex mMutex;
+    std::unordered_map<std::string, std::shared_ptr<const StaticAsset>> mAssets;
+
+    std::mutex mWatchMutex;
+    int mInotifyFd = -1;
+    std::unordered_map<int, std::string> mWatches;
+    std::atomic<uint64_t> mLastCheckMS = 0; // claimed before any lock, so requests between checks skip it all
+
+    std::shared_ptr<const StaticAsset> load(const std::string &key);
+    void watch(const std::string &dir);
+    void checkInvalidations();
+};
+
+std::string_view mimeTypeFor(std::string_view path);
+
+// A strong ETag (quoted SHA-1 hex) for content.
+std::string computeETag(std::string_view content);
+
+bool acceptsGzip(std::string_view acceptEncoding);
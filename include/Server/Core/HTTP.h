@@ -1,5 +1,9 @@
 #include "Server.h"
 
-HttpMethod parseHttpMethod(const std::string &method);
+HttpMethod parseHttpMethod(std::string_view method);
 
-std::unordered_map<std::string, std::string> parseQueryParams(const std::string &query);
+// Decodes %XX escapes, and '+' as a space when form is set. Returns false if the input isn't validly encoded.
+bool urlDecode(std::string_view in, std::string &out, bool form);
+
+// Keys and values are url decoded, a key without '=' maps to an empty value.
+std::unordered_map<std::string, std::string> parseQueryParams(std::string_view query);
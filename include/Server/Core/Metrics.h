@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Fixed-bucket histogram. Observing is a couple of relaxed atomic adds, buckets are only made cumulative when rendered.
+class Histogram {
+  public:
+    explicit Histogram(std::initializer_list<double> bounds);
+
+    void observe(double seconds);
+
+    // Appends the _bucket/_sum/_count lines for name, labels is either empty or "key=\"value\"".
+    void render(std::string &out, const std::string &name, const std::string &labels) const;
+
+  private:
+    std::vector<double> mBounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> mCounts; // one per bound plus +Inf
+    std::atomic<uint64_t> mSumMicros{ 0 };
+};
+
+// Owned by each CacheContainer. A hit is a read served from a reasonably fresh snapshot, a miss one where nothing was
+// probed yet or the probe fell far behind its timer.
+struct CacheStats {
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+};
+
+// Process wide counters for /metrics, rendered in the Prometheus text format. Everything on the request path is a
+// relaxed atomic; the route and cache tables are only modified while the server starts up, so lookups need no lock.
+class Metrics {
+  public:
+    static Metrics &get() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    Metrics(const Metrics &) = delete;
+    Metrics &operator=(const Metrics &) = delete;
+
+    void addRoute(const std::string &route);
+    void addCache(const std::string &name, const CacheStats *stats);
+
+    // route is the pattern that matched (ResponseData::route), anything not registered is counted as "unmatched".
+    void recordRequest(std::string_view route, int status, double seconds, bool reusedConnection);
+
+    // Time a worker spent handling events in one mg_mgr_poll() call, not counting the wait for I/O.
+    void recordPoll(double seconds) { mPollSeconds.observe(seconds); }
+
+    void addBytesIn(uint64_t n) { mBytesIn.fetch_add(n, std::memory_order_relaxed); }
+    void addBytesOut(uint64_t n) { mBytesOut.fetch_add(n, std::memory_order_relaxed); }
+
+    void connectionOpened() { mConnections.fetch_add(1, std::memory_order_relaxed); }
+    void connectionClosed() { mConnections.fetch_sub(1, std::memory_order_relaxed); }
+    void websocketOpened() { mWebsockets.fetch_add(1, std::memory_order_relaxed); }
+    void websocketClosed() { mWebsockets.fetch_sub(1, std::memory_order_relaxed); }
+
+    std::string render() const;
+
+  private:
+    Metrics();
+
+    static constexpr int StatusCodes[] = { 101, 200, 204, 206, 301, 302, 304, 400, 401,
+                                           403, 404, 405, 411, 413, 416, 500, 502, 503 };
+    static constexpr size_t StatusSlots = std::size(StatusCodes) + 1; // last slot counts anything else
+
+    struct RouteMetrics {
+        RouteMetrics();
+
+        Histogram latency;
+        std::atomic<uint64_t> statuses[StatusSlots];
+    };
+
+    struct RouteHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view route) const { return std::hash<std::string_view>{}(route); }
+    };
+
+    mutable std::mutex mRegistryMutex; // only taken when registering and rendering
+    std::unordered_map<std::string, std::unique_ptr<RouteMetrics>, RouteHash, std::equal_to<>> mRoutes;
+    RouteMetrics mUnmatched;
+    std::vector<std::pair<std::string, const CacheStats *>> mCaches;
+
+    std::atomic<uint64_t> mRequests{ 0 };
+    std::atomic<uint64_t> mReusedRequests{ 0 };
+    std::atomic<uint64_t> mBytesIn{ 0 };
+    std::atomic<uint64_t> mBytesOut{ 0 };
+    std::atomic<int64_t> mConnections{ 0 };
+    std::atomic<int64_t> mWebsockets{ 0 };
+
+    Histogram mPollSeconds;
+
+    static size_t statusSlot(int status);
+};
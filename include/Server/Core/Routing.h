@@ -1,31 +1,86 @@
 #pragma once
 
+#include <Server/Core/Server.h>
+
+#include <functional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
-inline std::vector<std::string> __route_prefix_stack;
+// Route table built once at startup. Exact routes live in one hash map per method and are looked up with the request
+// path directly (no temporary strings), mounts match by prefix with the longest one winning. Registration happens
+// before the server starts, so dispatching from several workers needs no locking.
+class Router {
+  public:
+    using Handler = std::function<void(const RequestData &req, ResponseData &res)>;
+
+    void add(HttpMethod method, const std::string &path, Handler handler);
+    void mount(const std::string &prefix, Handler handler);
+
+    // Runs the matching handler, HEAD falls back to the GET routes. Returns false if nothing matched.
+    bool dispatch(const RequestData &req, ResponseData &res) const;
+
+    // Used by ROUTE() while registering, so nested routes pick up the enclosing prefixes.
+    void pushPrefix(const std::string &prefix) { mPrefixes.push_back(prefix); }
+    void popPrefix() { mPrefixes.pop_back(); }
+    std::string prefixed(const std::string &path) const;
+
+  private:
+    struct PathHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view path) const { return std::hash<std::string_view>{}(path); }
+    };
+
+    static constexpr size_t MethodCount = (size_t)HttpMethod::PATCH + 1;
 
-inline std::string __route_prefix() {
+    std::unordered_map<std::string, Handler, PathHash, std::equal_to<>> mRoutes[MethodCount];
+    std::vector<std::pair<std::string, Handler>> mMounts; // longest prefix first
+    std::vector<std::string> mPrefixes;
+};
+
+inline Router gRouter;
+
+struct __RouteScope {
+    explicit __RouteScope(const std::string &prefix) { gRouter.pushPrefix(prefix); }
+    ~__RouteScope() { gRouter.popPrefix(); }
+    bool done = false;
+};
+
+struct __RouteRegistrar {
+    HttpMethod method;
     std::string path;
-    for (auto &p : __route_prefix_stack)
-        path += p;
-    return path;
-}
+    bool isMount = false;
+
+    void operator=(Router::Handler handler) {
+        if (isMount) {
+            gRouter.mount(path, std::move(handler));
+        } else {
+            gRouter.add(method, path, std::move(handler));
+        }
+    }
+};
+
+// The macros register the block that follows them as a handler, so they're only used while building the table (see
+// registerRoutes in Routes.cpp) and each block ends with "};".
+
+#define ROUTE(prefix) for (__RouteScope __route_scope(prefix); !__route_scope.done; __route_scope.done = true)
 
-inline bool starts_with(const std::string &s, const std::string &prefix) {
-    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
-}
+#define __ROUTE_HANDLER(__method, __path)                                                                              \
+    __RouteRegistrar{ __method, gRouter.prefixed(__path) } =                                                           \
+        []([[maybe_unused]] const RequestData &req, [[maybe_unused]] ResponseData &res)
 
-#define ROUTE(prefix)                                                                                                  \
-    if (starts_with(req.path, __route_prefix() + prefix))                                                              \
-        for (__route_prefix_stack.push_back(prefix); !__route_prefix_stack.empty(); __route_prefix_stack.pop_back())
+#define GET(__path) __ROUTE_HANDLER(HttpMethod::GET, __path)
 
-#define GET(__path) if (req.method == HttpMethod::GET && req.path == (__route_prefix() + __path))
+#define POST(__path) __ROUTE_HANDLER(HttpMethod::POST, __path)
 
-#define POST(__path) if (req.method == HttpMethod::POST && req.path == (__route_prefix() + __path))
+#define PUT(__path) __ROUTE_HANDLER(HttpMethod::PUT, __path)
 
-#define PUT(__path) if (req.method == HttpMethod::PUT && req.path == (__route_prefix() + __path))
+#define PATCH(__path) __ROUTE_HANDLER(HttpMethod::PATCH, __path)
 
-#define PATCH(__path) if (req.method == HttpMethod::PATCH && req.path == (__route_prefix() + __path))
+#define DELETE_(__path) __ROUTE_HANDLER(HttpMethod::DELETE_, __path)
 
-#define DELETE_(__path) if (req.method == HttpMethod::DELETE && req.path == (__route_prefix() + __path))
+// Matches every method and every path below prefix.
+#define MOUNT(__prefix)                                                                                                \
+    __RouteRegistrar{ HttpMethod::GET, gRouter.prefixed(__prefix), true } =                                            \
+        []([[maybe_unused]] const RequestData &req, [[maybe_unused]] ResponseData &res)
@@ -1,68 +1,119 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include <mongoose.h>
 
+#include <Server/Core/AssetCache.h>
+
 enum class HttpMethod { HEAD, GET, DELETE_, POST, PUT, CONNECT, OPTIONS, TRACE, PATCH };
 
+// A view of the request mongoose parsed. Everything points into the connection's receive buffer, so it's only valid
+// while the handler runs. Headers are looked up on demand, query parameters and cookies are parsed on first access.
 struct RequestData {
-    std::string url;
-    std::string scheme;
-    std::string host;
-    std::string subdomain;
-    std::string domain;
-    std::string port;
-    std::string path;
-    std::string query_string;
-    std::unordered_map<std::string, std::string> query_params;
+    RequestData(const struct mg_http_message *hm, const struct mg_connection *c);
 
-    HttpMethod method;
+    // path may point into the object itself
+    RequestData(const RequestData &) = delete;
+    RequestData &operator=(const RequestData &) = delete;
 
-    std::unordered_map<std::string, std::string> headers;
-    std::unordered_map<std::string, std::string> cookies;
+    const struct mg_http_message *message;
 
-    std::string body;
-    std::string content_type;
+    HttpMethod method;
+    std::string_view url;  // request target as sent, without the query string
+    std::string_view path; // url with percent-escapes decoded
+    std::string_view query_string;
+
+    std::string_view body;
     size_t content_length = 0;
-    std::string user_agent;
 
-    std::string remote_address;
+    struct mg_addr remote;
     uint16_t remote_port = 0;
 
-    std::string http_version;
+    std::string_view scheme;
+    std::string_view http_version;
     bool is_secure = false;
 
-    std::string getHeader(const std::string &key) const;
-    std::string getQueryParam(const std::string &key) const;
-    std::string getCookie(const std::string &key) const;
+    // Case-insensitive, empty if the header wasn't sent.
+    std::string_view getHeader(std::string_view key) const;
+    bool hasHeader(std::string_view key) const;
+
+    std::string_view getQueryParam(const std::string &key) const;
+    std::string_view getCookie(std::string_view key) const;
+
+    std::string_view getHost() const { return getHeader("Host"); }
+    std::string_view getContentType() const { return getHeader("Content-Type"); }
+    std::string_view getUserAgent() const { return getHeader("User-Agent"); }
+    std::string_view getSubdomain() const;
+    std::string_view getDomain() const;
+    std::string getRemoteAddress() const;
+
+  private:
+    std::string decoded_path; // only filled when the url had escapes in it
+
+    mutable std::optional<std::unordered_map<std::string, std::string>> query_params;
+    mutable std::optional<std::vector<std::pair<std::string_view, std::string_view>>> cookies;
+
+    const struct mg_str *findHeader(std::string_view key) const;
+};
+
+// Headers of a cached response that only change with its snapshot, formatted once when the snapshot is stored.
+struct CachedHeaders {
+    std::string content_type;
+    std::string etag;    // quoted, what If-None-Match is checked against. Empty before the first refresh
+    std::string lines;   // Cache-Control and the weak ETag, each ending in CRLF
+    uint64_t timing = 0; // when the snapshot was taken, the Age is counted from it
 };
 
+// Sends the ETag weak, the body may still differ in fields that change on every refresh.
+std::shared_ptr<const CachedHeaders> makeCachedHeaders(const std::string &contentType, std::string etag,
+                                                       uint64_t timing);
+
 struct ResponseData {
     int status = 200;
     std::unordered_map<std::string, std::string> headers;
     std::unordered_map<std::string, std::string> cookies;
 
     std::string body;
+    std::shared_ptr<const std::string> shared_body; // sent instead of body when set, so cached buffers aren't copied
+    std::shared_ptr<const StaticAsset> asset;       // set by respondAsset so the encoding can be negotiated later
+    std::shared_ptr<const CachedHeaders> cached;    // set by setCachedBody, written instead of Content-Type
     std::string content_type = "text/plain";
     bool keep_alive = true;
 
     bool handled = false;
+    std::string_view route; // pattern the router matched, points into the route table
 
     void setHeader(const std::string &key, const std::string &value);
     void setCookie(const std::string &name, const std::string &value, const std::string &path = "/",
                    const std::string &extra = "");
     void setBody(const std::string &b, const std::string &type = "");
+    void setSharedBody(std::shared_ptr<const std::string> b, const std::string &type = "");
+    // A cached body with its preformatted headers, nothing is copied or formatted but the Age line.
+    void setCachedBody(std::shared_ptr<const std::string> b, std::shared_ptr<const CachedHeaders> h);
 
-    void respondDirectory(const std::string &dir, const std::string &part, const std::string &url);
+    const std::string &getBody() const { return shared_body ? *shared_body : body; }
+
+    void respondDirectory(const std::string &dir, const std::string &part, std::string_view url);
     void respondFile(const std::string &filepath);
+    void respondAsset(const std::shared_ptr<const StaticAsset> &asset);
 };
 
+// Runs one mongoose manager per worker thread, each with its own listener on the shared port (SO_REUSEPORT), so the
+// kernel spreads incoming connections across cores. Websocket sends to a connection owned by another worker are queued
+// on that worker and handed over with mg_wakeup().
 class NoreServer {
   public:
-    NoreServer(std::string address, std::function<bool(const RequestData &, ResponseData &)> handler);
+    NoreServer(std::string address, std::function<bool(const RequestData &, ResponseData &)> handler, int workers = 1);
 
     void run();
     bool onRequest(const RequestData &data, ResponseData &res);
@@ -75,15 +126,53 @@ class NoreServer {
     void broadcastWebsockets(const std::string &data);
 
   private:
+    struct Worker;
+
+    struct WSConnection {
+        Worker *worker;
+        struct mg_connection *conn;
+        unsigned long connId;
+    };
+
+    struct WSOutgoing {
+        struct mg_connection *conn;
+        unsigned long connId;
+        std::string data;
+    };
+
+    struct Worker {
+        NoreServer *server;
+        struct mg_mgr mgr;
+        struct mg_connection *listener = nullptr;
+        std::atomic<std::thread::id> threadId; // set by the worker thread, read by any thread sending to it
+
+        std::mutex outboxMutex;
+        std::vector<WSOutgoing> outbox;
+    };
+
     std::string mHostAddress;
     std::function<bool(const RequestData &, ResponseData &)> mHandlerFunction;
     std::function<void(const std::string &)> mWSConnect, mWSClose;
     std::function<void(const std::string &, const std::string &)> mWSMessage;
 
+    int mWorkerCount;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    std::mutex mWSMutex;
     std::unordered_map<struct mg_connection *, std::string> mWSIds;
-    std::unordered_map<std::string, struct mg_connection *> mWSReverseLookup;
+    std::unordered_map<std::string, WSConnection> mWSReverseLookup;
 
-    friend void ev_handler(struct mg_connection *c, int ev, void *ev_data);
+    void runWorker(Worker &worker);
+    void sendToWebsocket(const WSConnection &ws, const std::string &data);
+    void flushWebsocketOutbox(Worker &worker);
+
+    friend void handleEvent(struct mg_connection *c, int ev, void *ev_data, std::string_view &route);
 };
 
+// Appends the header lines for res (each ending in CRLF, without the blank line) to out. Content-Length is only written
+// when contentLength is set.
+void writeResponseHeaders(std::string &out, const ResponseData &res, std::optional<uint64_t> contentLength);
+
 std::string constructResponseHeaders(const ResponseData &res);
+
+std::string getMGEventString(int ev);
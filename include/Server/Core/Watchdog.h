@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Times every event handler call and every mg_mgr_poll() iteration. Anything over the budget is logged with the route
+// and event that caused it, and kept for a while so /metrics can show where the tail latency comes from. Calls within
+// budget only touch a few relaxed atomics.
+class StallWatchdog {
+  public:
+    static StallWatchdog &get() {
+        static StallWatchdog watchdog;
+        return watchdog;
+    }
+
+    StallWatchdog(const StallWatchdog &) = delete;
+    StallWatchdog &operator=(const StallWatchdog &) = delete;
+
+    // 0 turns the reports off, the worst-case stats are still kept.
+    void setBudget(uint64_t ms) { mBudgetMicros.store(ms * 1000, std::memory_order_relaxed); }
+    uint64_t getBudget() const { return mBudgetMicros.load(std::memory_order_relaxed) / 1000; }
+
+    using Clock = std::chrono::steady_clock;
+
+    void recordHandler(int ev, std::string_view route, Clock::time_point started, Clock::time_point finished);
+
+    // slowestEv/slowestRoute name the slowest handler call of the iteration, so a slow poll points somewhere.
+    void recordPoll(Clock::time_point started, Clock::time_point finished, int slowestEv,
+                    std::string_view slowestRoute);
+
+    // Appends the worst-case gauges and stall counters in the Prometheus text format.
+    void render(std::string &out) const;
+
+  private:
+    StallWatchdog() = default;
+
+    static constexpr uint64_t WindowSeconds = 60;
+    static constexpr size_t MaxReports = 256;
+
+    // Worst duration per second over the last WindowSeconds, each slot is reset when a new second claims it.
+    class RollingMax {
+      public:
+        void record(uint64_t micros, uint64_t second);
+        uint64_t max(uint64_t now) const;
+
+      private:
+        struct Slot {
+            std::atomic<uint64_t> second{ 0 };
+            std::atomic<uint64_t> micros{ 0 };
+        };
+
+        Slot mSlots[WindowSeconds];
+    };
+
+    struct Report {
+        uint64_t second;
+        bool poll;
+        int ev;
+        std::string route;
+        uint64_t micros;
+    };
+
+    std::atomic<uint64_t> mBudgetMicros{ 50 * 1000 };
+
+    RollingMax mHandlerWorst;
+    RollingMax mPollWorst;
+    std::atomic<uint64_t> mHandlerStalls{ 0 };
+    std::atomic<uint64_t> mPollStalls{ 0 };
+
+    mutable std::mutex mReportsMutex; // only taken once a budget was blown
+    std::deque<Report> mReports;
+
+    void report(bool poll, int ev, std::string_view route, uint64_t micros, uint64_t second);
+};
@@ -0,0 +1,69 @@
+#ifndef DASHSRV_DELTAFRAME_H__
+#define DASHSRV_DELTAFRAME_H__
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Binary websocket frames that only carry what changed in a topic's document since a version the client acknowledged.
+//
+// Documents are flattened into leaf fields ("players.online", "data.2.ips.0", ...) and every path is given a numeric id
+// the first time it shows up. All integers below are LEB128 varints unless noted otherwise.
+//
+//   u8      kind          1 = full snapshot, 2 = delta
+//   u8      topic length, followed by the topic name
+//   varint  base version  0 for full snapshots
+//   varint  version
+//   varint  definitions   then (id, name length, name) for each id the client can't know yet
+//   varint  sets          then (id, type, value) for each field that was added or changed
+//   varint  removals      then (id) for each field that no longer exists
+//
+// Value types: 0 null, 1 false, 2 true, 3 signed int (zigzag), 4 unsigned int, 5 double (8 bytes, little endian),
+// 6 string (length + utf-8), 7 empty array, 8 empty object.
+namespace DeltaFrame {
+
+enum Kind : uint8_t { Full = 1, Delta = 2 };
+
+// Keeps the last few versions of one topic's document so deltas can be built against any of them. Thread safe.
+class TopicHistory {
+  public:
+    explicit TopicHistory(std::string topic, size_t depth = 8);
+
+    // Records a new version of the document and returns its number (versions start at 1).
+    uint32_t push(const nlohmann::json &document);
+
+    // 0 until the first push
+    uint32_t version() const;
+
+    // A delta from baseVersion to the latest version, or a full snapshot when baseVersion is 0 or no longer kept.
+    std::string encode(uint32_t baseVersion) const;
+
+  private:
+    using Fields = std::map<uint32_t, nlohmann::json>;
+
+    struct Version {
+        uint32_t number;
+        Fields fields;
+    };
+
+    std::string mTopic;
+    size_t mDepth;
+
+    mutable std::mutex mMutex;
+    std::deque<Version> mVersions;
+    std::unordered_map<std::string, uint32_t> mIds;
+    std::vector<std::string> mNames; // indexed by id
+
+    uint32_t fieldId(const std::string &path);
+    void flatten(const nlohmann::json &value, const std::string &path, Fields &out);
+};
+
+} // namespace DeltaFrame
+
+#endif // DASHSRV_DELTAFRAME_H__
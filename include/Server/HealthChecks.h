@@ -0,0 +1,84 @@
+#ifndef DASHSRV_HEALTHCHECKS_H__
+#define DASHSRV_HEALTHCHECKS_H__
+
+#include <Server/Statuses.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct mg_connection;
+struct mg_mgr;
+
+struct HealthCheckTarget {
+    std::string Name;
+    bool HTTP; // otherwise a TCP connect is all there is to it
+    std::string IP;
+    int Port;
+
+    std::string Path;       // http only
+    int ExpectStatus;       // http only, 0 accepts anything below 400
+    std::string ExpectBody; // http only, the body has to contain it, empty skips the check
+
+    uint64_t IntervalMS;
+    uint64_t TimeoutMS;
+};
+
+// Runs every tcp/http check on a single thread and mg_mgr, so hundreds of them cost one thread instead of one each.
+// Every check has its own interval (with +/- 10% jitter, like ProbeScheduler), a check that's still running when it
+// comes due again is not started twice.
+class HealthCheckEngine {
+  public:
+    // Gets every check's latest status, called from the engine thread after a loop iteration in which checks finished.
+    using Listener = std::function<void(const std::vector<HealthCheckStatus> &statuses)>;
+
+    HealthCheckEngine() = default;
+    ~HealthCheckEngine();
+
+    HealthCheckEngine(const HealthCheckEngine &) = delete;
+    HealthCheckEngine &operator=(const HealthCheckEngine &) = delete;
+
+    void addCheck(const HealthCheckTarget &target);
+    bool empty() const { return mTargets.empty(); }
+
+    void start(Listener listener);
+    void stop();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Attempt {
+        HealthCheckEngine *Engine;
+        size_t Index;
+        struct mg_connection *Conn = nullptr;
+        Clock::time_point Started;
+        double ConnectMS = -1;
+        double FirstByteMS = -1;
+        std::string Error;
+        bool Finished = false;
+    };
+
+    std::vector<HealthCheckTarget> mTargets;
+    std::vector<HealthCheckStatus> mStatuses;
+    std::vector<Clock::time_point> mNextDue;
+    std::vector<std::unique_ptr<Attempt>> mAttempts; // null while the check is idle
+
+    Listener mListener;
+    bool mChanged = false;
+
+    std::thread mThread;
+    std::atomic<bool> mStopping{ false };
+
+    void run();
+    void begin(struct mg_mgr *mgr, size_t index, Clock::time_point now);
+    void finish(Attempt *attempt, bool up, const std::string &error, int status = 0);
+
+    friend void check_ev_handler(struct mg_connection *c, int ev, void *ev_data);
+};
+
+#endif // DASHSRV_HEALTHCHECKS_H__
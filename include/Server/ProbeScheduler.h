@@ -0,0 +1,44 @@
+#ifndef DASHSRV_PROBESCHEDULER_H__
+#define DASHSRV_PROBESCHEDULER_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs each registered probe on its own thread, off the request path. Probes are repeated every intervalMS with
+// +/- 10% jitter so upstreams that share an interval don't all get hit in the same instant.
+class ProbeScheduler {
+  public:
+    ProbeScheduler() = default;
+    ~ProbeScheduler();
+
+    ProbeScheduler(const ProbeScheduler &) = delete;
+    ProbeScheduler &operator=(const ProbeScheduler &) = delete;
+
+    void addProbe(const std::string &name, uint64_t intervalMS, std::function<void()> probe);
+
+    void start();
+    void stop();
+
+  private:
+    struct Probe {
+        std::string name;
+        uint64_t intervalMS;
+        std::function<void()> fn;
+    };
+
+    std::vector<Probe> mProbes;
+    std::vector<std::thread> mThreads;
+
+    std::mutex mMutex;
+    std::condition_variable mStopSignal;
+    bool mStopping = false;
+
+    void runProbe(const Probe &probe);
+};
+
+#endif // DASHSRV_PROBESCHEDULER_H__
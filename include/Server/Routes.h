@@ -2,4 +2,23 @@
 
 #include <Server/Core/Server.h>
 
+#include <functional>
+#include <string>
+
+// Receives a topic ("mc", "jellyfin", "mesh", "local" or "checks") and its new JSON document. Called from the probe
+// threads whenever a refresh produced data that differs from the last push.
+using RoutesPublisher = std::function<void(const std::string &topic, const std::string &document)>;
+
+// Must be set before initRoutes() starts the probes.
+void setRoutesPublisher(RoutesPublisher publisher);
+
+// The JSON document for a topic's current snapshot, or an empty string if the topic isn't known or configured.
+std::string getTopicSnapshot(const std::string &topic);
+
+// Loads the config, builds the route table and starts the probes.
+void initRoutes();
+
+// Only builds the route table, for when the probes shouldn't run (see dashsrv_bench).
+void registerRoutes();
+
 bool handleRoutes(const RequestData &req, ResponseData &res);
@@ -3,6 +3,10 @@
 #include <Server/Core/Server.h>
 
 #include <Server/Client.h>
+#include <Server/DeltaFrame.h>
+
+#include <memory>
+#include <mutex>
 
 class ServiceHandler {
   public:
@@ -22,11 +26,19 @@ class ServiceHandler {
 
   private:
     NoreServer *mServer = nullptr;
+
+    std::mutex mClientsMutex; // websocket callbacks run on the server workers, publishes on the probe threads
     std::unordered_map<std::string, UserClient> mClients;
+    std::unordered_map<std::string, std::unique_ptr<DeltaFrame::TopicHistory>> mTopics;
 
     ServiceHandler() = default;
 
     void onWebsocketConnect(const std::string &id);
     void onWebsocketClose(const std::string &id);
     void onWebsocketMessage(const std::string &id, const std::string &data);
+
+    void publish(const std::string &topic, const std::string &document);
+    // Creates the history on first use, starting from seed or else from the topic's current snapshot. Requires
+    // mClientsMutex.
+    DeltaFrame::TopicHistory *topicHistory(const std::string &topic, const nlohmann::json *seed = nullptr);
 };
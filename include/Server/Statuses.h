@@ -0,0 +1,85 @@
+#ifndef DASHSRV_SERVER_STATUSES_H__
+#define DASHSRV_SERVER_STATUSES_H__
+
+#include <Minecraft/MCDef.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One configured Minecraft server and the outcome of its last probe.
+struct MinecraftServerStatus {
+    std::string Name;
+    std::string IP;
+    std::string Domain;
+    int Port;
+    int RequestProtocol;
+    bool Query; // polled over UDP, Status has every player's name but no icon or protocol
+
+    Minecraft::MCStatus Status; // without the favicon, that's served on its own
+    std::string IconHash;       // the decoded icon's, at /api/mc/icon/{hash}, empty if the server has none
+};
+
+struct MinecraftNetworkStatus {
+    std::vector<MinecraftServerStatus> Servers;
+};
+
+struct JellyfinStatus {
+    bool Online;
+    std::string Health;
+
+    std::string LocalAddress;
+    std::string ServerName;
+    std::string Version;
+    std::string ProductName;
+    std::string OperatingSystem;
+    std::string ID;
+    bool StartupWizardComplete;
+};
+
+struct DashboardStatus {
+    std::vector<std::string> IPs;
+    struct {
+        uint64_t Available;
+        uint64_t Total;
+    } Memory;
+    double CPU;
+    uint64_t Ping;
+    bool IsCurrent;
+    bool Online;
+};
+
+struct DashboardHealthStatus {
+    std::vector<DashboardStatus> Statuses;
+};
+
+// Last outcome of a generic tcp or http check. The times are -1 when the attempt didn't get that far.
+struct HealthCheckStatus {
+    std::string Name;
+    std::string Type;   // "tcp" or "http"
+    std::string Target; // ip:port, plus the path for http
+
+    bool Checked = false; // false until the first attempt finished
+    bool Up = false;
+    std::string Error;
+    int Status = 0; // http only
+
+    double ConnectMS = -1;
+    double FirstByteMS = -1;
+    double TotalMS = -1;
+    uint64_t CheckedAt = 0;
+};
+
+struct HealthCheckReport {
+    std::vector<HealthCheckStatus> Checks;
+};
+
+// The JSON bodies served by the /api routes and pushed to websocket subscribers.
+std::string MCStatusToJSON(const MinecraftServerStatus &status, uint64_t cacheTiming);
+std::string MCNetworkToJSON(const MinecraftNetworkStatus &status, uint64_t cacheTiming);
+std::string JellyfinStatusToJSON(const JellyfinStatus &status, uint64_t cacheTiming);
+std::string DashboardStatusToJSON(const DashboardStatus &status, uint64_t cacheTiming);
+std::string HealthReportToJSON(const DashboardHealthStatus &status, uint64_t cacheTiming);
+std::string HealthChecksToJSON(const HealthCheckReport &report, uint64_t cacheTiming);
+
+#endif // DASHSRV_SERVER_STATUSES_H__
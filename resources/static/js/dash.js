@@ -1,11 +1,7 @@
 const IP = document.getElementById("current-ip");
 
 const MCCacheTimer = document.getElementById("mc-cache-timer");
-const MCIcon = document.getElementById("mc-server-icon");
-const MCTitle = document.getElementById("mc-server-title");
-const MCMOTD = document.getElementById("mc-server-motd");
-const MCPlayers = document.getElementById("mc-players");
-const MCPing = document.getElementById("mc-ping");
+const MCServers = document.getElementById("mc-servers");
 
 const JFCacheTimer = document.getElementById("jellyfin-cache-timer");
 const JFName = document.getElementById("jellyfin-server-name");
@@ -16,6 +12,9 @@ const JFVersion = document.getElementById("jellyfin-version");
 
 const Servers = document.getElementById("servers");
 
+const ChecksSection = document.getElementById("checks-section");
+const Checks = document.getElementById("checks");
+
 async function APIGet(url) {
   try {
     const req = await fetch(url);
@@ -42,17 +41,11 @@ function Datify(ms) {
   return dateCache.toLocaleString(undefined, dateOptions);
 }
 
-async function updateServerList() {
-  const data = await APIGet("/api/status");
-  if (!data.success) {
-    setTimeout(updateServerList, 30500);
-    return;
-  }
-
+function renderServerList(report) {
   Servers.innerHTML = "";
 
   let hasFailure = false;
-  for (const server of data.data.data) {
+  for (const server of report.data) {
     const div = document.createElement("div");
     div.classList.add("server");
 
@@ -76,56 +69,97 @@ async function updateServerList() {
     Servers.appendChild(div);
   }
 
-  if (hasFailure) {
-    setTimeout(updateServerList, 15500);
-    return;
-  }
-
-  setTimeout(updateServerList, 5500);
-  return;
+  return hasFailure;
 }
 
-async function updateMCServerInfo() {
-  const data = await APIGet("/api/mc");
-  if (!data.success) {
-    return;
-  }
+// One box per configured server, kept across renders so icons aren't reloaded every refresh
+const MCBoxes = {};
 
-  MCCacheTimer.innerText = Datify(data.data.cacheTiming);
+function createMCServerBox() {
+  const box = document.createElement("div");
+  box.classList.add("minecraft-server-box");
+
+  const element = (tag, cls) => {
+    const el = document.createElement(tag);
+    el.classList.add(cls, "mc-font");
+    box.appendChild(el);
+    return el;
+  };
 
-  if (data.data.online) {
-    MCIcon.src = data.data.icon;
-    MCTitle.innerText = `KittenCraft (${data.data.version.name})`;
-    MCMOTD.innerText = data.data.motd;
-    MCMOTD.classList.remove("mc-motd-disconnected");
-    MCPlayers.innerText = `${data.data.players.online}/${data.data.players.max}`;
-    MCPing.innerText = `${data.data.ping}ms`;
+  const icon = document.createElement("img");
+  icon.classList.add("mc-server-icon");
+  icon.alt = "icon";
+  box.appendChild(icon);
+
+  return {
+    box,
+    icon,
+    title: element("h2", "mc-server-title"),
+    motd: element("p", "mc-server-motd"),
+    players: element("p", "mc-players"),
+    ping: element("p", "mc-ping"),
+  };
+}
+
+function renderMCServer(view, status) {
+  if (status.online) {
+    // icons are served by hash and cached for good, the image only changes when the hash does
+    if (view.iconHash !== status.iconHash) {
+      view.iconHash = status.iconHash;
+      view.icon.src = status.iconHash ? `/api/mc/icon/${status.iconHash}` : `/static/pack.jpg`;
+    }
+    view.title.innerText = `${status.name} (${status.version.name})`;
+    // rendered and escaped by the server, color and style classes only
+    view.motd.innerHTML = status.motdHtml ?? "";
+    view.motd.classList.remove("mc-motd-disconnected");
+    view.players.innerText = `${status.players.online}/${status.players.max}`;
+    view.players.title = (status.players.names || []).join(", ");
+    view.ping.innerText = `${status.ping}ms`;
   } else {
-    MCMOTD.classList.add("mc-motd-disconnected");
-    MCMOTD.innerText = `Can't connect to server.`;
-    MCTitle.innerText = `Minecraft Server`;
-    MCPlayers.innerText = `???`;
-    MCPing.innerText = `X`;
-    MCIcon.src = `/static/pack.jpg`;
+    view.motd.classList.add("mc-motd-disconnected");
+    view.motd.innerText = `Can't connect to server.`;
+    view.title.innerText = status.name;
+    view.players.innerText = `???`;
+    view.players.title = "";
+    view.ping.innerText = `X`;
+    if (view.iconHash !== "") {
+      view.iconHash = "";
+      view.icon.src = `/static/pack.jpg`;
+    }
   }
 }
 
-async function updateJellyfinInfo() {
-  const data = await APIGet("/api/jellyfin");
-  if (!data.success) {
-    return;
+function renderMCServers(report) {
+  MCCacheTimer.innerText = Datify(report.cacheTiming);
+
+  const seen = new Set();
+  for (const status of report.data) {
+    seen.add(status.name);
+    if (!MCBoxes[status.name]) MCBoxes[status.name] = createMCServerBox();
+
+    const view = MCBoxes[status.name];
+    renderMCServer(view, status);
+    MCServers.appendChild(view.box); // keeps the boxes in the order of the list
   }
 
-  JFCacheTimer.innerText = Datify(data.data.cacheTiming);
+  for (const name in MCBoxes) {
+    if (seen.has(name)) continue;
+    MCBoxes[name].box.remove();
+    delete MCBoxes[name];
+  }
+}
+
+function renderJellyfinInfo(status) {
+  JFCacheTimer.innerText = Datify(status.cacheTiming);
 
-  if (data.data.online) {
-    JFName.innerHTML = `${data.data.serverName} <i id="jellyfin-product-name">${data.data.productName}</i>`;
-    JFLocation.innerText = data.data.localAddress;
-    JFLocation.href = data.data.localAddress;
-    JFID.innerText = data.data.id;
-    JFVersion.innerText = data.data.version;
+  if (status.online) {
+    JFName.innerHTML = `${status.serverName} <i id="jellyfin-product-name">${status.productName}</i>`;
+    JFLocation.innerText = status.localAddress;
+    JFLocation.href = status.localAddress;
+    JFID.innerText = status.id;
+    JFVersion.innerText = status.version;
 
-    if (data.data.healthString == "Healthy") {
+    if (status.healthString == "Healthy") {
       JFName.style = "color: #00ff00;";
     } else {
       JFName.style = "color: #ffff00;";
@@ -140,6 +174,169 @@ async function updateJellyfinInfo() {
   }
 }
 
+function formatMS(ms) {
+  return ms == null ? "-" : `${ms.toFixed(1)}ms`;
+}
+
+function renderChecks(report) {
+  // hidden by the stylesheet until there are checks to show
+  ChecksSection.style.display = report.data.length > 0 ? "block" : "none";
+  Checks.innerHTML = "";
+
+  for (const check of report.data) {
+    const div = document.createElement("div");
+    div.classList.add("server");
+
+    const line = (tag, cls, text) => {
+      const el = document.createElement(tag);
+      el.classList.add(cls);
+      el.textContent = text;
+      div.appendChild(el);
+      return el;
+    };
+
+    line("h2", "server-ip", check.name);
+
+    let state = "Pending";
+    if (check.checked && check.up) state = check.type == "http" ? `Up (${check.status})` : "Up";
+    else if (check.checked) state = `Down: ${check.error}`;
+    line("p", "server-ping", state).classList.add(check.up ? "check-up" : "check-down");
+
+    line("p", "server-cpu", `Connect: ${formatMS(check.connectMS)}`);
+    line("p", "server-mem", check.type == "http" ? `TTFB: ${formatMS(check.ttfbMS)}` : check.target);
+
+    Checks.appendChild(div);
+  }
+}
+
+// Polling is only the fallback for when the websocket is down, the timers are dropped as soon as it's back
+const PollTimers = {};
+
+function schedulePoll(name, fn, ms) {
+  if (Live.connected) return;
+  PollTimers[name] = setTimeout(fn, ms);
+}
+
+function stopPolling() {
+  for (const name in PollTimers) {
+    clearTimeout(PollTimers[name]);
+    delete PollTimers[name];
+  }
+}
+
+async function updateServerList() {
+  const data = await APIGet("/api/status");
+  if (!data.success) {
+    schedulePoll("mesh", updateServerList, 30500);
+    return;
+  }
+
+  const hasFailure = renderServerList(data.data);
+  schedulePoll("mesh", updateServerList, hasFailure ? 15500 : 5500);
+}
+
+async function updateMCServerInfo() {
+  const data = await APIGet("/api/mc");
+  if (data.success) {
+    renderMCServers(data.data);
+  }
+
+  schedulePoll("mc", updateMCServerInfo, 10500);
+}
+
+async function updateJellyfinInfo() {
+  const data = await APIGet("/api/jellyfin");
+  if (data.success) {
+    renderJellyfinInfo(data.data);
+  }
+
+  schedulePoll("jellyfin", updateJellyfinInfo, 30500);
+}
+
+async function updateChecks() {
+  const data = await APIGet("/api/checks");
+  if (data.success) {
+    renderChecks(data.data);
+    schedulePoll("checks", updateChecks, 10500);
+  }
+  // without any checks configured the route doesn't exist, so there's nothing to poll
+}
+
+function startPolling() {
+  if (Live.connected || Object.keys(PollTimers).length > 0) return;
+
+  updateServerList();
+  updateMCServerInfo();
+  updateJellyfinInfo();
+  updateChecks();
+}
+
+// Live updates: the server pushes what changed in a topic whenever a refresh changes it
+const Live = {
+  socket: null,
+  connected: false,
+  retryMS: 1000,
+  topics: ["mesh", "mc", "jellyfin", "checks"],
+  handlers: {
+    mesh: renderServerList,
+    mc: renderMCServers,
+    jellyfin: renderJellyfinInfo,
+    checks: renderChecks,
+  },
+};
+
+function connectLive() {
+  if (!("WebSocket" in window)) {
+    startPolling();
+    return;
+  }
+
+  const scheme = location.protocol == "https:" ? "wss:" : "ws:";
+  const socket = new WebSocket(`${scheme}//${location.host}/ws`);
+  socket.binaryType = "arraybuffer";
+  Live.socket = socket;
+
+  const decoder = new DeltaDecoder();
+
+  socket.onopen = () => {
+    Live.connected = true;
+    Live.retryMS = 1000;
+    stopPolling();
+    socket.send(JSON.stringify({ subscribe: Live.topics }));
+  };
+
+  socket.onmessage = (event) => {
+    if (typeof event.data == "string") return;
+
+    let frame;
+    try {
+      frame = decoder.decode(event.data);
+    } catch (err) {
+      return;
+    }
+
+    if (frame.resync) {
+      socket.send(JSON.stringify({ resync: [frame.topic] }));
+      return;
+    }
+
+    // the next delta will be based on this version
+    socket.send(JSON.stringify({ ack: { [frame.topic]: frame.version } }));
+
+    const handler = Live.handlers[frame.topic];
+    if (handler) handler(frame.document);
+  };
+
+  socket.onclose = () => {
+    Live.connected = false;
+    Live.socket = null;
+    startPolling();
+
+    setTimeout(connectLive, Live.retryMS);
+    Live.retryMS = Math.min(Live.retryMS * 2, 30000);
+  };
+}
+
 async function main() {
   const data = await APIGet("/api/local");
 
@@ -159,13 +356,7 @@ async function main() {
 
   IP.innerText = currentIP;
 
-  updateServerList();
-  updateMCServerInfo();
-  updateJellyfinInfo();
-
-  // no setInterval for updateServerList since it is self managed
-  setInterval(updateMCServerInfo, 10500);
-  setInterval(updateJellyfinInfo, 30500);
+  connectLive();
 }
 
 (() => {
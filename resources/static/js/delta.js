@@ -0,0 +1,132 @@
+// Decodes the binary delta frames pushed over /ws, see include/Server/DeltaFrame.h for the layout
+
+const DeltaKind = { Full: 1, Delta: 2 };
+
+class DeltaReader {
+  constructor(buffer) {
+    this.bytes = new Uint8Array(buffer);
+    this.view = new DataView(buffer);
+    this.pos = 0;
+    this.text = new TextDecoder();
+  }
+
+  u8() {
+    return this.bytes[this.pos++];
+  }
+
+  // plain arithmetic instead of bit shifts, those would truncate to 32 bits
+  varint() {
+    let value = 0;
+    let scale = 1;
+    for (;;) {
+      const byte = this.u8();
+      value += (byte & 0x7f) * scale;
+      if ((byte & 0x80) == 0) return value;
+      scale *= 128;
+    }
+  }
+
+  string(length = this.varint()) {
+    const str = this.text.decode(this.bytes.subarray(this.pos, this.pos + length));
+    this.pos += length;
+    return str;
+  }
+
+  value() {
+    switch (this.u8()) {
+      case 1:
+        return false;
+      case 2:
+        return true;
+      case 3: {
+        const n = this.varint();
+        return n % 2 == 0 ? n / 2 : -(n + 1) / 2;
+      }
+      case 4:
+        return this.varint();
+      case 5: {
+        const v = this.view.getFloat64(this.pos, true);
+        this.pos += 8;
+        return v;
+      }
+      case 6:
+        return this.string();
+      case 7:
+        return [];
+      case 8:
+        return {};
+      default:
+        return null;
+    }
+  }
+}
+
+function unflatten(names, fields) {
+  const root = {};
+  for (const [id, value] of fields) {
+    const parts = names.get(id).split(".");
+
+    let node = root;
+    for (let i = 0; i < parts.length - 1; ++i) {
+      if (node[parts[i]] === undefined) node[parts[i]] = /^\d+$/.test(parts[i + 1]) ? [] : {};
+      node = node[parts[i]];
+    }
+
+    node[parts[parts.length - 1]] = value;
+  }
+
+  return root;
+}
+
+// Keeps the last few versions of each topic, deltas are applied on top of whichever version the server based them on
+class DeltaDecoder {
+  constructor(depth = 8) {
+    this.depth = depth;
+    this.topics = new Map();
+  }
+
+  // Returns { topic, version, document }, or { topic, resync: true } when the frame can't be applied
+  decode(buffer) {
+    const reader = new DeltaReader(buffer);
+    const kind = reader.u8();
+    const topic = reader.string(reader.u8());
+    const base = reader.varint();
+    const version = reader.varint();
+
+    if (!this.topics.has(topic) || kind == DeltaKind.Full) {
+      this.topics.set(topic, { names: new Map(), versions: new Map() });
+    }
+    const state = this.topics.get(topic);
+
+    let fields;
+    if (kind == DeltaKind.Full) {
+      fields = new Map();
+    } else if (state.versions.has(base)) {
+      fields = new Map(state.versions.get(base));
+    } else {
+      return { topic, resync: true };
+    }
+
+    for (let n = reader.varint(); n > 0; --n) {
+      const id = reader.varint();
+      state.names.set(id, reader.string());
+    }
+
+    for (let n = reader.varint(); n > 0; --n) {
+      const id = reader.varint();
+      fields.set(id, reader.value());
+    }
+
+    for (let n = reader.varint(); n > 0; --n) {
+      fields.delete(reader.varint());
+    }
+
+    state.versions.set(version, fields);
+    for (const old of state.versions.keys()) {
+      if (state.versions.size <= this.depth) break;
+      state.versions.delete(old);
+    }
+
+    return { topic, version, document: unflatten(state.names, fields) };
+  }
+}
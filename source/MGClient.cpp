@@ -4,66 +4,281 @@
 
 #include <mongoose.h>
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 
-static void mg_ev_handler(mg_connection *c, int ev, void *ev_data) {
-    MGResponse *res = static_cast<MGResponse *>(c->fn_data);
+namespace Dashcli {
+
+struct PendingRequest {
+    MGResponse *Response;
+    const MGRequest *Request;
+    uint64_t StartMS;
+    bool Retried = false;
+};
+
+struct PooledConnection {
+    Client *Owner = nullptr;
+    mg_connection *Conn = nullptr;
+    std::string Host;
+
+    std::deque<PendingRequest *> Inflight = {}; // responses arrive in request order, so the front is always next
+    uint64_t LastUsedMS = 0;
+    size_t Served = 0;
+    bool Reusable = true;
+
+    std::string Error = "";
+};
+
+static std::string poolKey(const std::string &url) {
+    struct mg_str host = mg_url_host(url.c_str());
+    return std::string(host.buf, host.len) + ":" + std::to_string(mg_url_port(url.c_str()));
+}
+
+static void finishRequest(PendingRequest *req, bool success, const std::string &reason) {
+    if (req->Response->Done)
+        return;
+
+    req->Response->Success = success;
+    req->Response->Done = true;
+    req->Response->Reason = reason;
+    req->Response->ElapsedMS = GetTimeMillis() - req->StartMS;
+}
+
+void pool_ev_handler(mg_connection *c, int ev, void *ev_data) {
+    PooledConnection *pc = static_cast<PooledConnection *>(c->fn_data);
 
     switch (ev) {
-    case MG_EV_CONNECT: {
-        struct mg_str host = mg_url_host(res->URL.c_str());
-        mg_printf(c,
-                  "GET %s HTTP/1.1\r\n"
-                  "Host: %.*s\r\n"
-                  "User-Agent: dashsrv/1.0.0\r\n"
-                  "Accept: */*\r\n"
-                  "\r\n",
-                  mg_url_uri(res->URL.c_str()), (int)host.len, host.buf);
+    case MG_EV_HTTP_MSG: {
+        pc->Owner->onResponse(pc, (struct mg_http_message *)ev_data);
         break;
     }
-    case MG_EV_HTTP_MSG: {
-        struct mg_http_message *hm = (struct mg_http_message *)ev_data;
-        res->Recv.insert(res->Recv.end(), hm->body.buf, hm->body.buf + hm->body.len);
-        res->Success = true;
-        res->Done = true;
+    case MG_EV_ERROR: {
+        pc->Error = (const char *)ev_data;
+        break;
+    }
+    case MG_EV_CLOSE: {
+        pc->Owner->onClose(pc, pc->Error.empty() ? "Connection closed" : pc->Error);
         break;
     }
     }
 }
 
-namespace Dashcli {
-
-MGResponse Get(std::string url) {
+Client::Client() {
     mg_log_set(MG_LL_ERROR);
+    mg_mgr_init(&mMgr);
+}
 
-    if (!url.starts_with("http://") || !url.starts_with("https://")) {
-        url = "http://" + url;
-    }
+Client::~Client() { mg_mgr_free(&mMgr); }
 
-    MGResponse res;
-    res.URL = url;
-    res.Success = false;
+static std::string lowercase(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char ch) { return std::tolower(ch); });
+    return str;
+}
+
+MGResponse Client::get(const std::string &url, uint64_t timeoutMS) { return getAll({ url }, timeoutMS)[0]; }
+
+std::vector<MGResponse> Client::getAll(const std::vector<std::string> &urls, uint64_t timeoutMS) {
+    std::vector<MGRequest> requests;
+    requests.reserve(urls.size());
+    for (const auto &url : urls) {
+        requests.push_back({ url, {} });
+    }
+    return getAll(requests, timeoutMS);
+}
 
-    mg_mgr mgr;
-    mg_mgr_init(&mgr);
+std::vector<MGResponse> Client::getAll(const std::vector<MGRequest> &reqs, uint64_t timeoutMS) {
+    // pick up any connections the remote side closed while we weren't polling, so they aren't handed out again
+    mg_mgr_poll(&mMgr, 0);
+    evictIdle();
 
-    mg_http_connect(&mgr, url.c_str(), mg_ev_handler, &res);
+    std::vector<MGResponse> responses(reqs.size());
+    std::vector<PendingRequest> requests(reqs.size());
 
-    uint64_t timeout = 3000; // 3000 ms timeout
     uint64_t start = GetTimeMillis();
+    for (size_t i = 0; i < reqs.size(); ++i) {
+        std::string url = reqs[i].URL;
+        if (!url.starts_with("http://") && !url.starts_with("https://")) {
+            url = "http://" + url;
+        }
+
+        responses[i].URL = url;
+        responses[i].Success = false;
+        requests[i] = { &responses[i], &reqs[i], start };
+    }
+
+    for (auto &req : requests) {
+        dispatch(&req);
+    }
+
+    auto pending = [&]() {
+        for (const auto &res : responses) {
+            if (!res.Done)
+                return true;
+        }
+        return false;
+    };
+
+    while (pending() && (GetTimeMillis() - start < timeoutMS)) {
+        mg_mgr_poll(&mMgr, 50);
+    }
+
+    // anything still in flight is out of sync with its connection now, so those connections can't be reused
+    for (auto &[host, pool] : mPools) {
+        for (PooledConnection *pc : pool) {
+            if (pc->Inflight.empty())
+                continue;
+
+            for (PendingRequest *req : pc->Inflight) {
+                finishRequest(req, false, "Timed out");
+            }
+            pc->Inflight.clear();
+            pc->Reusable = false;
+            pc->Conn->is_closing = 1;
+        }
+    }
+    mg_mgr_poll(&mMgr, 0);
+
+    return responses;
+}
+
+void Client::dispatch(PendingRequest *req) {
+    const std::string &url = req->Response->URL;
 
-    while (!res.Done && (GetTimeMillis() - start < timeout)) {
-        mg_mgr_poll(&mgr, 50);
+    PooledConnection *pc = acquire(url);
+    if (pc == nullptr) {
+        finishRequest(req, false, "Connection failed");
+        return;
     }
 
-    res.Reason = "Connection closed";
-    if (res.Success == false && GetTimeMillis() - start >= timeout) {
-        res.Reason = "Timed out";
+    std::string extra;
+    for (const auto &[name, value] : req->Request->Headers) {
+        extra += name + ": " + value + "\r\n";
     }
 
-    mg_mgr_free(&mgr);
+    struct mg_str host = mg_url_host(url.c_str());
+    mg_printf(pc->Conn,
+              "GET %s HTTP/1.1\r\n"
+              "Host: %.*s\r\n"
+              "User-Agent: dashsrv/1.0.0\r\n"
+              "Accept: */*\r\n"
+              "Connection: keep-alive\r\n"
+              "%s"
+              "\r\n",
+              mg_url_uri(url.c_str()), (int)host.len, host.buf, extra.c_str());
 
-    return res;
+    pc->Inflight.push_back(req);
+    pc->LastUsedMS = GetTimeMillis();
+}
+
+PooledConnection *Client::acquire(const std::string &url) {
+    std::string key = poolKey(url);
+    auto &pool = mPools[key];
+
+    // prefer an idle connection, then pipeline behind the least busy one, and only then open a new one
+    PooledConnection *best = nullptr;
+    for (PooledConnection *pc : pool) {
+        if (!pc->Reusable || pc->Conn->is_closing || pc->Conn->is_draining)
+            continue;
+
+        if (pc->Inflight.empty())
+            return pc;
+
+        if (pc->Inflight.size() < mMaxPipelineDepth && (best == nullptr || pc->Inflight.size() < best->Inflight.size()))
+            best = pc;
+    }
+
+    if (best != nullptr || pool.size() >= mMaxConnectionsPerHost)
+        return best;
+
+    PooledConnection *pc = new PooledConnection{ .Owner = this, .Host = key };
+    pc->Conn = mg_http_connect(&mMgr, url.c_str(), pool_ev_handler, pc);
+    if (pc->Conn == nullptr) {
+        delete pc;
+        return nullptr;
+    }
+
+    pool.push_back(pc);
+    return pc;
+}
+
+void Client::evictIdle() {
+    uint64_t now = GetTimeMillis();
+    for (auto &[host, pool] : mPools) {
+        for (PooledConnection *pc : pool) {
+            if (pc->Inflight.empty() && now - pc->LastUsedMS > mIdleTimeoutMS) {
+                pc->Reusable = false;
+                pc->Conn->is_draining = 1;
+            }
+        }
+    }
+}
+
+void Client::onResponse(PooledConnection *pc, struct mg_http_message *hm) {
+    if (pc->Inflight.empty())
+        return;
+
+    PendingRequest *req = pc->Inflight.front();
+    pc->Inflight.pop_front();
+
+    req->Response->Recv.insert(req->Response->Recv.end(), hm->body.buf, hm->body.buf + hm->body.len);
+    req->Response->Status = mg_http_status(hm);
+    for (size_t i = 0; i < MG_MAX_HTTP_HEADERS && hm->headers[i].name.len > 0; i++) {
+        std::string name = lowercase(std::string(hm->headers[i].name.buf, hm->headers[i].name.len));
+        req->Response->Headers[name] = std::string(hm->headers[i].value.buf, hm->headers[i].value.len);
+    }
+    finishRequest(req, true, "OK");
+
+    pc->Served++;
+    pc->LastUsedMS = GetTimeMillis();
+
+    struct mg_str *connection = mg_http_get_header(hm, "Connection");
+    if (connection != nullptr && mg_strcasecmp(*connection, mg_str("close")) == 0) {
+        pc->Reusable = false;
+        if (pc->Inflight.empty())
+            pc->Conn->is_draining = 1;
+    }
+}
+
+void Client::onClose(PooledConnection *pc, const std::string &reason) {
+    auto &pool = mPools[pc->Host];
+    std::erase(pool, pc);
+
+    std::deque<PendingRequest *> orphaned;
+    orphaned.swap(pc->Inflight);
+
+    // a kept-alive connection can be closed by the server at any point, give its requests one more try on a fresh one
+    bool wasReused = pc->Served > 0;
+    delete pc;
+
+    for (PendingRequest *req : orphaned) {
+        if (wasReused && !req->Retried) {
+            req->Retried = true;
+            dispatch(req);
+        } else {
+            finishRequest(req, false, reason);
+        }
+    }
+}
+
+Client &ThreadClient() {
+    static thread_local Client client;
+    return client;
+}
+
+MGResponse Get(std::string url) { return ThreadClient().get(url); }
+
+std::vector<MGResponse> GetAll(const std::vector<std::string> &urls, uint64_t timeoutMS) {
+    return ThreadClient().getAll(urls, timeoutMS);
+}
+
+std::vector<MGResponse> GetAll(const std::vector<MGRequest> &requests, uint64_t timeoutMS) {
+    return ThreadClient().getAll(requests, timeoutMS);
 }
 
 } // namespace Dashcli
+
+std::string MGResponse::GetHeader(const std::string &name) const {
+    auto it = Headers.find(Dashcli::lowercase(name));
+    return it != Headers.end() ? it->second : "";
+}
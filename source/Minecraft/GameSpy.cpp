@@ -0,0 +1,292 @@
+#include <Minecraft/GameSpy.h>
+
+#include <Minecraft/MCPacket.h>
+#include <Minecraft/String.h>
+
+#include <mongoose.h>
+
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+namespace Minecraft {
+    using namespace packetool;
+
+    // Reads a null terminated string at pos and moves pos past the terminator, false if there's no terminator.
+    static bool ReadCString(const uint8_t *data, size_t len, size_t &pos, std::string_view &out) {
+        const void *end = pos < len ? std::memchr(data + pos, 0, len - pos) : nullptr;
+        if (end == nullptr)
+            return false;
+
+        size_t strLen = static_cast<const uint8_t *>(end) - (data + pos);
+        out = std::string_view(reinterpret_cast<const char *>(data + pos), strLen);
+        pos += strLen + 1;
+        return true;
+    }
+
+    static bool ReadNumber(std::string_view text, int &out) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    }
+
+    void gamespy_ev_handler(struct mg_connection *c, int ev, __attribute__((unused)) void *ev_data) {
+        GameSpyClient *client = static_cast<GameSpyClient *>(c->mgr->userdata);
+        GameSpyClient::Session *session = static_cast<GameSpyClient::Session *>(c->fn_data);
+
+        switch (ev) {
+        case MG_EV_CONNECT: {
+            // an ip is resolved right away, before mg_connect has even returned the connection
+            session->Conn = c;
+            if (session->Current == GameSpyClient::Stage::Connecting)
+                client->send(*session, GetTimeMS());
+            break;
+        }
+        case MG_EV_READ: {
+            // every read is one datagram
+            const uint8_t *data = c->recv.buf;
+            size_t len = c->recv.len;
+            uint64_t now = GetTimeMS();
+
+            if (len >= 5 && (uint32_t)ReadInt(data + 1) == session->SessionID) {
+                if (session->Current == GameSpyClient::Stage::Challenge && data[0] == GS_PACKET_HANDSHAKE) {
+                    if (inte__::ParseQueryChallenge(data, len, session->SessionID, session->Token)) {
+                        session->HasToken = true;
+                        session->Retried = false;
+                        client->send(*session, now);
+                    }
+                } else if (session->Current == GameSpyClient::Stage::Stat && data[0] == GS_PACKET_STAT) {
+                    session->Status = ParseFullStatResponse(data, len);
+                    session->Status.PingMS = now - session->SentMS;
+                    session->Current = GameSpyClient::Stage::Done;
+                }
+            }
+
+            c->recv.len = 0;
+            break;
+        }
+        case MG_EV_CLOSE: {
+            // only happens when resolving or sending failed, the socket is opened again on the next poll
+            session->Conn = nullptr;
+            session->HasToken = false;
+            if (session->Current != GameSpyClient::Stage::Idle && session->Current != GameSpyClient::Stage::Done)
+                client->finish(*session, "Failed to reach the server's query port");
+            break;
+        }
+        }
+    }
+
+    GameSpyClient::GameSpyClient() {
+        mgr = new mg_mgr;
+        mg_mgr_init(mgr);
+        mgr->userdata = this;
+    }
+
+    GameSpyClient::~GameSpyClient() {
+        mg_mgr_free(mgr);
+        delete mgr;
+    }
+
+    std::vector<MCStatus> GameSpyClient::QueryServers(const std::vector<MCServer> &servers, uint64_t timeoutMS) {
+        mg_log_set(MG_LL_ERROR);
+
+        std::vector<Session *> polled;
+        for (const MCServer &server : servers) {
+            std::string addr = server.IP + ":" + std::to_string(server.Port);
+            Session &session = sessions[addr];
+            polled.push_back(&session);
+
+            // the same server listed twice is polled once
+            if (session.Current != Stage::Idle)
+                continue;
+
+            session.Status = MCStatus();
+            session.Retried = false;
+            if (session.Conn != nullptr && session.Conn->is_resolving) {
+                session.Current = Stage::Connecting; // still resolving from an earlier poll
+                continue;
+            }
+            if (session.Conn != nullptr) {
+                send(session, GetTimeMS());
+                continue;
+            }
+
+            session.Current = Stage::Connecting;
+            session.Conn = mg_connect(mgr, ("udp://" + addr).c_str(), gamespy_ev_handler, &session);
+            if (session.Conn == nullptr)
+                finish(session, "Failed to reach the server's query port");
+        }
+
+        uint64_t start = GetTimeMS();
+        while (true) {
+            uint64_t now = GetTimeMS();
+            bool pending = false;
+            for (Session *session : polled) {
+                bool waiting = session->Current == Stage::Challenge || session->Current == Stage::Stat;
+                if (waiting && !session->Retried && now - session->SentMS >= RetryMS) {
+                    // a reused token that's not answered has most likely expired, a new one is asked for
+                    if (session->Current == Stage::Stat && session->HasToken)
+                        session->HasToken = false;
+                    session->Retried = true;
+                    send(*session, now);
+                }
+
+                pending |= session->Current != Stage::Done;
+            }
+
+            if (!pending || now - start >= timeoutMS)
+                break;
+
+            mg_mgr_poll(mgr, 10);
+        }
+
+        std::vector<MCStatus> statuses;
+        for (Session *session : polled) {
+            if (session->Current != Stage::Done)
+                finish(*session, "Server didn't answer the query (is enable-query on?)");
+            statuses.push_back(session->Status);
+        }
+
+        for (Session *session : polled)
+            session->Current = Stage::Idle;
+
+        return statuses;
+    }
+
+    void GameSpyClient::send(Session &session, uint64_t now) {
+        // a new session id per request, so a late answer to an earlier request can't be taken for this one. The
+        // counter's nibbles are spread over the bits GS_SESSION_MASK allows, so ids only repeat every 65536 requests.
+        uint32_t id;
+        do {
+            uint32_t n = nextSessionID++;
+            id = (n & 0xF) | (n >> 4 & 0xF) << 8 | (n >> 8 & 0xF) << 16 | (n >> 12 & 0xF) << 24;
+        } while (id == 0 || id == session.SessionID);
+        session.SessionID = id;
+        session.SentMS = now;
+
+        std::vector<uint8_t> packet;
+        if (session.HasToken) {
+            session.Current = Stage::Stat;
+            packet = inte__::BuildFullStatRequestPacket(session.SessionID, session.Token);
+        } else {
+            session.Current = Stage::Challenge;
+            packet = inte__::BuildQueryHandshakePacket(session.SessionID);
+        }
+
+        mg_send(session.Conn, packet.data(), packet.size());
+    }
+
+    void GameSpyClient::finish(Session &session, const std::string &error) {
+        session.Status = MCStatus();
+        session.Status.Online = false;
+        session.Status.Error = error;
+        session.Current = Stage::Done;
+    }
+
+    MCStatus ParseFullStatResponse(const uint8_t *data, size_t len) {
+        static constexpr std::string_view Padding("splitnum\0\x80\0", 11);
+        static constexpr std::string_view PlayerSection("\x01player_\0\0", 10);
+
+        MCStatus status = MCStatus();
+        status.Online = false;
+        status.Error = "Server responded to query with a malformed full stat";
+
+        if (len < 5 || data[0] != GS_PACKET_STAT)
+            return status;
+
+        size_t pos = 5;
+        std::string_view rest(reinterpret_cast<const char *>(data + pos), len - pos);
+        if (rest.starts_with(Padding))
+            pos += Padding.size();
+
+        // key/value section, ends with an empty key
+        bool hasPlayers = false, hasMax = false;
+        while (true) {
+            std::string_view key, value;
+            if (!ReadCString(data, len, pos, key))
+                return status;
+            if (key.empty())
+                break;
+            if (!ReadCString(data, len, pos, value))
+                return status;
+
+            if (key == "hostname") {
+                status.MOTD = FormatText(value, TextFormat::Plain);
+                status.MOTDHtml = FormatText(value, TextFormat::Html);
+            } else if (key == "version") {
+                status.Version.Name = value;
+            } else if (key == "numplayers") {
+                hasPlayers = ReadNumber(value, status.Players.Online);
+            } else if (key == "maxplayers") {
+                hasMax = ReadNumber(value, status.Players.Max);
+            }
+        }
+
+        if (!hasPlayers || !hasMax)
+            return status;
+
+        // player section, one name after the other, ends with an empty name
+        rest = std::string_view(reinterpret_cast<const char *>(data + pos), len - pos);
+        if (!rest.starts_with(PlayerSection))
+            return status;
+        pos += PlayerSection.size();
+
+        while (true) {
+            std::string_view name;
+            if (!ReadCString(data, len, pos, name))
+                return status;
+            if (name.empty())
+                break;
+            status.Players.Names.emplace_back(name);
+        }
+
+        status.Online = true;
+        status.Error = "No error";
+        return status;
+    }
+
+    namespace inte__ {
+        std::vector<uint8_t> BuildQueryHandshakePacket(uint32_t sessionID) {
+            std::vector<uint8_t> packet;
+
+            {
+                WriteShort(packet, (int16_t)GS_MAGIC);
+                packet.push_back(GS_PACKET_HANDSHAKE);
+                WriteInt(packet, (int32_t)sessionID);
+            }
+
+            return packet;
+        }
+
+        std::vector<uint8_t> BuildFullStatRequestPacket(uint32_t sessionID, int32_t token) {
+            std::vector<uint8_t> packet;
+
+            {
+                WriteShort(packet, (int16_t)GS_MAGIC);
+                packet.push_back(GS_PACKET_STAT);
+                WriteInt(packet, (int32_t)sessionID);
+                WriteInt(packet, token);
+                WriteInt(packet, 0); // padding, without it the server sends a basic stat
+            }
+
+            return packet;
+        }
+
+        bool ParseQueryChallenge(const uint8_t *data, size_t len, uint32_t sessionID, int32_t &token) {
+            if (len < 5 || data[0] != GS_PACKET_HANDSHAKE || (uint32_t)ReadInt(data + 1) != sessionID)
+                return false;
+
+            // the token comes as null terminated decimal text
+            size_t pos = 5;
+            std::string_view text;
+            if (!ReadCString(data, len, pos, text))
+                return false;
+
+            int value = 0;
+            if (!ReadNumber(text, value))
+                return false;
+
+            token = value;
+            return true;
+        }
+    }
+}
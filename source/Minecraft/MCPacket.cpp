@@ -127,6 +127,52 @@ namespace Minecraft {
                              );
         }
 
+        int TryReadVarInt(const uint8_t *data, size_t len, int32_t &value) {
+            uint32_t result = 0;
+
+            for (size_t i = 0; i < 5; ++i) {
+                if (i >= len) return 0;
+
+                result |= (uint32_t)(data[i] & SEGMENT_BITS) << (7 * i);
+                if ((data[i] & CONTINUE_BIT) == 0) {
+                    value = (int32_t)result;
+                    return (int)i + 1;
+                }
+            }
+
+            return -1;
+        }
+
+        void PacketFramer::Feed(const uint8_t *data, size_t len) {
+            // drop what was already handed out before growing, so the buffer stays around one packet in size
+            if (offset > 0 && offset >= buffer.size() / 2) {
+                buffer.erase(buffer.begin(), buffer.begin() + offset);
+                offset = 0;
+            }
+
+            buffer.insert(buffer.end(), data, data + len);
+        }
+
+        bool PacketFramer::Next(std::vector<uint8_t> &packet) {
+            if (malformed) return false;
+
+            int32_t length = 0;
+            int used = TryReadVarInt(buffer.data() + offset, buffer.size() - offset, length);
+            if (used == 0) return false;
+
+            if (used < 0 || length <= 0 || length > MaxPacketSize) {
+                malformed = true;
+                return false;
+            }
+
+            if (buffer.size() - offset - used < (size_t)length) return false;
+
+            auto start = buffer.begin() + offset + used;
+            packet.assign(start, start + length);
+            offset += used + length;
+            return true;
+        }
+
         int64_t ReadLong(const uint8_t* data) {
             return (int64_t)(
                              (uint64_t(data[0]) << 56) |
@@ -22,14 +22,27 @@ static void mc_ev_handler(mg_connection *c, int ev, __attribute__((unused)) void
     }
     case MG_EV_READ: {
         mg_iobuf *buf = &c->recv;
-        state->Recv.insert(state->Recv.end(), buf->buf, buf->buf + buf->len);
+        state->Framer.Feed(buf->buf, buf->len);
+        state->LastRecvMS = Minecraft::packetool::GetTimeMS();
         buf->len = 0;
+
+        std::vector<uint8_t> packet;
+        while (!state->Done && state->Framer.Next(packet)) {
+            if (state->OnPacket(packet)) {
+                state->Success = true;
+                state->Done = true;
+                c->is_closing = 1;
+            }
+        }
+
+        if (state->Framer.Malformed()) {
+            state->Done = true;
+            c->is_closing = 1;
+        }
         break;
     }
     case MG_EV_CLOSE: {
-        if (!state->Recv.empty()) {
-            state->Success = true;
-        }
+        // closed before the exchange completed, by the server or because the query was given up on
         state->Done = true;
         break;
     }
@@ -37,25 +50,47 @@ static void mc_ev_handler(mg_connection *c, int ev, __attribute__((unused)) void
 }
 
 namespace Minecraft {
-    void QueryMinecraft(MCQueryState &state, const MCServer &server, std::function<void(MCSendBytes)> onConnect) {
-        mg_log_set(MG_LL_ERROR);
-        
+    void QueryMinecraft(MCQueryState &state, const MCServer &server, std::function<void(MCSendBytes)> onConnect,
+                        std::function<bool(std::vector<uint8_t> &packet)> onPacket) {
         state.Server = &server;
         state.OnConnect = onConnect;
+        state.OnPacket = onPacket;
+
+        QueryMinecraftAll({ &state });
+    }
+
+    void QueryMinecraftAll(const std::vector<MCQueryState *> &states, uint64_t timeoutMS) {
+        mg_log_set(MG_LL_ERROR);
 
         mg_mgr mgr;
         mg_mgr_init(&mgr);
 
-        std::string addr = "tcp://" + server.IP + ":" + std::to_string(server.Port);
-        mg_connect(&mgr, addr.c_str(), mc_ev_handler, &state);
+        for (MCQueryState *state : states) {
+            std::string addr = "tcp://" + state->Server->IP + ":" + std::to_string(state->Server->Port);
+            if (mg_connect(&mgr, addr.c_str(), mc_ev_handler, state) == nullptr) {
+                state->Done = true;
+            }
+        }
+
+        auto pending = [&] {
+            for (const MCQueryState *state : states) {
+                if (!state->Done)
+                    return true;
+            }
+            return false;
+        };
 
-        uint64_t timeout = 3 * 1000; // 3 seconds
         uint64_t start = packetool::GetTimeMS();
 
-        while (!state.Done && (packetool::GetTimeMS() - start < timeout)) {
+        while (pending() && (packetool::GetTimeMS() - start < timeoutMS)) {
             mg_mgr_poll(&mgr, 50);
         }
 
+        // whatever is still connected timed out
+        for (MCQueryState *state : states) {
+            state->Done = true;
+        }
+
         mg_mgr_free(&mgr);
     }
 }
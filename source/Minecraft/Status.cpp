@@ -2,93 +2,166 @@
 
 #include <Minecraft/MCPacket.h>
 #include <Minecraft/MCQuery.h>
+#include <Minecraft/String.h>
 
+#include <mongoose.h>
 #include <nlohmann/json.hpp>
 
 #include <vector>
 #include <chrono>
 #include <cstdint>
 #include <cassert>
+#include <exception>
+#include <string>
+#include <type_traits>
 
 namespace Minecraft {
     using namespace packetool;
     
-    namespace inte__ {
-        std::vector<uint8_t> BuildHandshakePacket(const MCServer &server);
-        std::vector<uint8_t> BuildStatusRequestPacket();
-        std::vector<uint8_t> BuildPingRequestPacket();
+    MCStatus QueryServer(const MCServer &server) {
+        return QueryServers({ server })[0];
     }
 
-    MCStatus QueryServer(const MCServer &server) {
-        MCStatus status;
-        
-        std::vector<uint8_t> handshakePacket = inte__::BuildHandshakePacket(server);
+    std::vector<MCStatus> QueryServers(const std::vector<MCServer> &servers) {
         std::vector<uint8_t> statusPacket = inte__::BuildStatusRequestPacket();
         std::vector<uint8_t> pingPacket = inte__::BuildPingRequestPacket();
 
-        MCQueryState query;
-        QueryMinecraft(query, server, [&](MCSendBytes sendBytes) {
-            sendBytes(handshakePacket);
-            sendBytes(statusPacket);
-            sendBytes(pingPacket);
-        });
+        struct Answer {
+            std::vector<uint8_t> Status;
+            std::vector<uint8_t> Pong;
+        };
+
+        std::vector<MCQueryState> queries(servers.size());
+        std::vector<Answer> answers(servers.size());
+        std::vector<MCQueryState *> pending;
+        for (size_t i = 0; i < servers.size(); ++i) {
+            MCQueryState &query = queries[i];
+            query.Server = &servers[i];
+            query.OnConnect = [&, handshakePacket = inte__::BuildHandshakePacket(servers[i])](MCSendBytes sendBytes) {
+                sendBytes(handshakePacket);
+                sendBytes(statusPacket);
+                sendBytes(pingPacket);
+            };
+            // the pong is the last thing the server sends, so it completes the exchange
+            query.OnPacket = [&answer = answers[i]](std::vector<uint8_t> &packet) {
+                if (packet[0] == MC_PACKETACC_PONG) {
+                    answer.Pong = std::move(packet);
+                    return true;
+                }
+
+                if (answer.Status.empty())
+                    answer.Status = std::move(packet);
+                return false;
+            };
+            pending.push_back(&query);
+        }
+
+        QueryMinecraftAll(pending);
+
+        std::vector<MCStatus> statuses(servers.size());
+        for (size_t i = 0; i < servers.size(); ++i) {
+            if (!queries[i].Success) {
+                statuses[i].Online = false;
+                statuses[i].Error = "Server failed to respond or denied the request";
+                continue;
+            }
+
+            // one server sending something unexpected only takes that server offline, not the whole batch
+            try {
+                statuses[i] = ParseStatusPackets(answers[i].Status, answers[i].Pong, queries[i].LastRecvMS);
+            } catch (const std::exception &e) {
+                statuses[i] = MCStatus();
+                statuses[i].Online = false;
+                statuses[i].Error = std::string("Failed to parse the status response: ") + e.what();
+            }
+        }
+
+        return statuses;
+    }
+
+    MCStatus ParseStatusResponse(std::vector<uint8_t> &recv, uint64_t receivedAtMS) {
+        PacketFramer framer;
+        framer.Feed(recv.data(), recv.size());
+
+        std::vector<uint8_t> statusPacket, pongPacket;
+        framer.Next(statusPacket);
+        framer.Next(pongPacket);
+        return ParseStatusPackets(statusPacket, pongPacket, receivedAtMS);
+    }
 
+    MCStatus ParseStatusPackets(const std::vector<uint8_t> &statusPacket, const std::vector<uint8_t> &pongPacket,
+                                uint64_t receivedAtMS) {
+        MCStatus status = MCStatus();
         status.Online = false;
         status.Error = "No error";
-        
-        if (!query.Success) {
-            status.Error = "Server failed to respond or denied the request";
-            return status;
-        }
 
-        uint8_t *statusStart = query.Recv.data();
-        uint8_t *pingStart;
-        
         // parsing
         {
-            int32_t statusLen = ReadVarInt(statusStart);
-            pingStart = statusStart + statusLen;
-            uint8_t *statusEnd = pingStart;
-            int32_t statusPacketId = ReadVarInt(statusStart);
-            __attribute__((unused)) int32_t jsonStringLen = ReadVarInt(statusStart);
-            __attribute__((unused)) int32_t pingLen = ReadVarInt(pingStart);
-            int32_t pingPacketId = ReadVarInt(pingStart);
-
-            if (pingPacketId != MC_PACKETACC_PONG) {
+            // pong: the id and the 8 byte timestamp of the ping, echoed back
+            if (pongPacket.size() != 9 || pongPacket[0] != MC_PACKETACC_PONG) {
                 status.Error = "Server responded to ping with a packet other than pong";
                 return status;
             }
 
-            if (statusPacketId != MC_PACKETACC_STATUS) {
+            // status: the id and a length prefixed json string
+            int32_t jsonLen = 0;
+            int used = statusPacket.empty() ? -1 : TryReadVarInt(&statusPacket[1], statusPacket.size() - 1, jsonLen);
+            if (statusPacket.empty() || statusPacket[0] != MC_PACKETACC_STATUS || used <= 0 || jsonLen < 0 ||
+                (size_t)jsonLen > statusPacket.size() - 1 - used) {
                 status.Error = "Server responded to status with a packet other than status";
                 return status;
             }
-            
-            uint64_t pingResponse = ReadLong(pingStart);
-            status.PingMS = packetool::GetTimeMS() - pingResponse;
+
+            uint64_t pingResponse = ReadLong(&pongPacket[1]);
+            status.PingMS = (receivedAtMS != 0 ? receivedAtMS : packetool::GetTimeMS()) - pingResponse;
 
             // now parse json
-            std::string_view sv(reinterpret_cast<const char *>(statusStart), statusEnd - statusStart);
+            std::string_view sv(reinterpret_cast<const char *>(&statusPacket[1 + used]), jsonLen);
             auto doc = nlohmann::json::parse(sv, nullptr, false);
 
-            if (!doc.is_discarded()) {
+            if (!doc.is_discarded() && doc.is_object()) {
+                // servers leave fields out or send them with other types, whatever doesn't fit is left at its default
+                auto readInt = [](const nlohmann::json &object, const char *key, auto &out) {
+                    auto it = object.find(key);
+                    if (it != object.end() && it->is_number_integer())
+                        out = it->template get<std::remove_reference_t<decltype(out)>>();
+                };
+                auto readString = [](const nlohmann::json &object, const char *key, std::string &out) {
+                    auto it = object.find(key);
+                    if (it != object.end() && it->is_string())
+                        out = it->template get<std::string>();
+                };
+
+                // rendered once here, a plain string or a chat component
                 if (doc.contains("description")) {
-                    status.MOTD = doc["description"];
+                    status.MOTD = FormatChatComponent(doc["description"], TextFormat::Plain);
+                    status.MOTDHtml = FormatChatComponent(doc["description"], TextFormat::Html);
                 }
 
-                if (doc.contains("players")) {
-                    status.Players.Online = doc["players"]["online"];
-                    status.Players.Max = doc["players"]["max"];
+                auto players = doc.find("players");
+                if (players != doc.end() && players->is_object()) {
+                    readInt(*players, "online", status.Players.Online);
+                    readInt(*players, "max", status.Players.Max);
+
+                    auto sample = players->find("sample");
+                    if (sample != players->end() && sample->is_array()) {
+                        for (const auto &player : *sample) {
+                            std::string name;
+                            if (player.is_object())
+                                readString(player, "name", name);
+                            if (!name.empty())
+                                status.Players.Names.push_back(std::move(name));
+                        }
+                    }
                 }
 
-                if (doc.contains("version")) {
-                    status.Version.Name = doc["version"]["name"];
-                    status.Version.Protocol = doc["version"]["protocol"];
+                auto version = doc.find("version");
+                if (version != doc.end() && version->is_object()) {
+                    readString(*version, "name", status.Version.Name);
+                    readInt(*version, "protocol", status.Version.Protocol);
                 }
 
-                if (doc.contains("favicon")) {
-                    status.Icon = doc["favicon"];
-                }
+                readString(doc, "favicon", status.Icon);
 
                 status.Online = true;
             } else {
@@ -100,6 +173,26 @@ namespace Minecraft {
         return status;
     }
 
+    bool DecodeFavicon(std::string_view favicon, std::string &png) {
+        static constexpr std::string_view Prefix = "data:image/png;base64,";
+        if (!favicon.starts_with(Prefix))
+            return false;
+        favicon.remove_prefix(Prefix.size());
+
+        // older servers wrap the base64 every 76 characters
+        std::string base64;
+        base64.reserve(favicon.size());
+        for (char c : favicon) {
+            if (c != '\n' && c != '\r')
+                base64.push_back(c);
+        }
+
+        png.resize(base64.size() / 4 * 3 + 1);
+        size_t len = mg_base64_decode(base64.data(), base64.size(), png.data(), png.size());
+        png.resize(len);
+        return len > 0;
+    }
+
     namespace inte__ {
         std::vector<uint8_t> BuildHandshakePacket(const MCServer &server) {
             std::vector<uint8_t> packet;
@@ -1,60 +1,320 @@
 #include <Minecraft/String.h>
 
-#include <unordered_map>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
 
 #define ESC "\033"
 
 namespace Minecraft {
 
-    std::string EscapeToAnsi(const std::string &input) {
-        std::string out;
-
-        static const std::unordered_map<char, std::string> colorMap = {
-            {'0', ESC "[30m"}, // Black
-            {'1', ESC "[34m"}, // Dark Blue
-            {'2', ESC "[32m"}, // Dark Green
-            {'3', ESC "[36m"}, // Dark Aqua / Cyan
-            {'4', ESC "[31m"}, // Dark Red
-            {'5', ESC "[35m"}, // Dark Purple / Magenta
-            {'6', ESC "[33m"}, // Gold / Yellow
-            {'7', ESC "[37m"}, // Gray
-            {'8', ESC "[90m"}, // Dark Gray
-            {'9', ESC "[94m"}, // Blue
-            {'a', ESC "[92m"}, // Green
-            {'b', ESC "[96m"}, // Aqua
-            {'c', ESC "[91m"}, // Red
-            {'d', ESC "[95m"}, // Light Purple
-            {'e', ESC "[93m"}, // Yellow
-            {'f', ESC "[97m"}, // White
-            {'r', ESC "[0m"}   // Reset
-        };
-
-        static const std::unordered_map<char, std::string> styleMap = {
-            {'l', ESC "[1m"}, // Bold
-            {'n', ESC "[4m"}, // Underline
-            {'o', ESC "[3m"}, // Italic
-            {'m', ESC "[9m"}, // Strikethrough
-            {'k', ""}         // Obfuscated -> ignore (optional)
-        };
-
-        std::string_view section = "\xC2\xA7";
-        for (size_t i = 0; i < input.size(); ++i) {
-            if (i + 2 < input.size() && input.substr(i, 2) == section) {
-                char code = input[i + 2];
-                i += 2;
-                if (colorMap.count(code)) {
-                    out += colorMap.at(code);
-                } else if (styleMap.count(code)) {
-                    out += styleMap.at(code);
-                }
-            } else {
-                out += input[i];
+    namespace {
+        enum : uint8_t {
+            STYLE_BOLD = 1,
+            STYLE_ITALIC = 2,
+            STYLE_UNDERLINE = 4,
+            STYLE_STRIKE = 8,
+            STYLE_OBFUSCATED = 16,
+        };
+
+        struct Style {
+            int8_t Color = -1; // 0..15, for hex colors the closest one, -1 is the default color
+            int32_t RGB = -1;  // only set for hex colors
+            uint8_t Flags = 0;
+
+            bool operator==(const Style &) const = default;
+        };
+
+        struct PaletteColor {
+            const char *Name; // in chat components
+            int32_t RGB;
+            const char *Ansi;
+        };
+
+        constexpr PaletteColor Palette[16] = {
+            { "black", 0x000000, "30" },     { "dark_blue", 0x0000AA, "34" },    { "dark_green", 0x00AA00, "32" },
+            { "dark_aqua", 0x00AAAA, "36" }, { "dark_red", 0xAA0000, "31" },     { "dark_purple", 0xAA00AA, "35" },
+            { "gold", 0xFFAA00, "33" },      { "gray", 0xAAAAAA, "37" },         { "dark_gray", 0x555555, "90" },
+            { "blue", 0x5555FF, "94" },      { "green", 0x55FF55, "92" },        { "aqua", 0x55FFFF, "96" },
+            { "red", 0xFF5555, "91" },       { "light_purple", 0xFF55FF, "95" }, { "yellow", 0xFFFF55, "93" },
+            { "white", 0xFFFFFF, "97" },
+        };
+
+        struct StyleName {
+            uint8_t Flag;
+            const char *Component; // the chat component field
+            const char *Ansi;      // nullptr if a terminal can't show it
+            char Code;             // the § code, also the html class suffix
+        };
+
+        constexpr StyleName StyleNames[] = {
+            { STYLE_BOLD, "bold", "1", 'l' },
+            { STYLE_ITALIC, "italic", "3", 'o' },
+            { STYLE_UNDERLINE, "underlined", "4", 'n' },
+            { STYLE_STRIKE, "strikethrough", "9", 'm' },
+            { STYLE_OBFUSCATED, "obfuscated", nullptr, 'k' },
+        };
+
+        // What the character after a § does, one entry per byte so every code is a single lookup.
+        enum class CodeKind : uint8_t { None, Color, Style, Reset };
+
+        struct Code {
+            CodeKind Kind = CodeKind::None;
+            uint8_t Value = 0;
+        };
+
+        constexpr std::array<Code, 256> MakeCodeTable() {
+            std::array<Code, 256> table{};
+            for (uint8_t i = 0; i < 16; ++i) {
+                char code = "0123456789abcdef"[i];
+                table[(uint8_t)code] = { CodeKind::Color, i };
+                table[(uint8_t)(code >= 'a' ? code - 'a' + 'A' : code)] = { CodeKind::Color, i };
+            }
+            for (const StyleName &style : StyleNames) {
+                table[(uint8_t)style.Code] = { CodeKind::Style, style.Flag };
+                table[(uint8_t)(style.Code - 'a' + 'A')] = { CodeKind::Style, style.Flag };
             }
+            table['r'] = table['R'] = { CodeKind::Reset, 0 };
+            return table;
         }
 
-        out += ESC "[0m";
+        // What a byte of text turns into, nullptr copies it as is. Control characters are dropped from every format
+        // so a server can't send its own escape sequences, the html table escapes markup on top of that.
+        constexpr std::array<const char *, 256> MakeEscapeTable(bool html) {
+            std::array<const char *, 256> table{};
+            for (int c = 0; c < 0x20; ++c)
+                table[c] = "";
+            table[0x7F] = "";
+            table['\n'] = html ? "<br>" : nullptr;
+            if (html) {
+                table['&'] = "&amp;";
+                table['<'] = "&lt;";
+                table['>'] = "&gt;";
+                table['"'] = "&quot;";
+                table['\''] = "&#39;";
+            }
+            return table;
+        }
+
+        constexpr std::array<Code, 256> CodeTable = MakeCodeTable();
+        constexpr std::array<const char *, 256> TextEscapes = MakeEscapeTable(false);
+        constexpr std::array<const char *, 256> HtmlEscapes = MakeEscapeTable(true);
+
+        constexpr int MaxComponentDepth = 32; // deeper extra[] nesting is cut off
+
+        int8_t ClosestColor(int32_t rgb) {
+            int8_t best = 0;
+            int bestDistance = -1;
+            for (int8_t i = 0; i < 16; ++i) {
+                int dr = ((rgb >> 16) & 0xFF) - ((Palette[i].RGB >> 16) & 0xFF);
+                int dg = ((rgb >> 8) & 0xFF) - ((Palette[i].RGB >> 8) & 0xFF);
+                int db = (rgb & 0xFF) - (Palette[i].RGB & 0xFF);
+                int distance = dr * dr + dg * dg + db * db;
+                if (bestDistance < 0 || distance < bestDistance) {
+                    best = i;
+                    bestDistance = distance;
+                }
+            }
+            return best;
+        }
+
+        // Collects styled text and writes it out in one format, style changes are only written once text follows.
+        class Writer {
+          public:
+            Writer(TextFormat format, size_t sizeHint)
+                : format(format), escapes(format == TextFormat::Html ? HtmlEscapes : TextEscapes) {
+                // style changes cost a few bytes of escape sequence or markup each, plain text only ever shrinks
+                out.reserve(format == TextFormat::Plain ? sizeHint : sizeHint * 2 + 32);
+            }
+
+            // § codes change the style up to the end of this text, not for whatever comes after it.
+            void Text(std::string_view text, Style style) {
+                size_t pos = 0;
+                while (pos < text.size()) {
+                    size_t mark = text.find("\xC2\xA7", pos);
+                    Run(text.substr(pos, mark == std::string_view::npos ? std::string_view::npos : mark - pos), style);
+                    if (mark == std::string_view::npos || mark + 2 >= text.size())
+                        break;
+
+                    uint8_t code = (uint8_t)text[mark + 2];
+                    if (code >= 0x80) {
+                        pos = mark + 2; // not a code, the start of the next character
+                        continue;
+                    }
+
+                    const Code &entry = CodeTable[code];
+                    if (entry.Kind == CodeKind::Color) {
+                        style = Style();
+                        style.Color = (int8_t)entry.Value;
+                    } else if (entry.Kind == CodeKind::Style) {
+                        style.Flags |= entry.Value;
+                    } else if (entry.Kind == CodeKind::Reset) {
+                        style = Style();
+                    }
+                    pos = mark + 3;
+                }
+            }
+
+            void Component(const nlohmann::json &component, Style style, int depth) {
+                if (depth > MaxComponentDepth)
+                    return;
+
+                if (component.is_string()) {
+                    Text(component.get_ref<const std::string &>(), style);
+                    return;
+                }
+                if (component.is_array()) {
+                    for (const auto &child : component)
+                        Component(child, style, depth + 1);
+                    return;
+                }
+                if (!component.is_object())
+                    return;
+
+                auto color = component.find("color");
+                if (color != component.end() && color->is_string())
+                    ApplyColor(style, color->get_ref<const std::string &>());
+                for (const StyleName &name : StyleNames) {
+                    auto flag = component.find(name.Component);
+                    if (flag != component.end() && flag->is_boolean())
+                        style.Flags = flag->get<bool>() ? (style.Flags | name.Flag) : (style.Flags & ~name.Flag);
+                }
+
+                auto text = component.find("text");
+                auto translate = component.find("translate");
+                auto fallback = component.find("fallback");
+                if (text != component.end() && text->is_string()) {
+                    Text(text->get_ref<const std::string &>(), style);
+                } else if (text != component.end() && (text->is_number() || text->is_boolean())) {
+                    Text(text->dump(), style);
+                } else if (fallback != component.end() && fallback->is_string()) {
+                    Text(fallback->get_ref<const std::string &>(), style);
+                } else if (translate != component.end() && translate->is_string()) {
+                    Text(translate->get_ref<const std::string &>(), style);
+                }
+
+                auto extra = component.find("extra");
+                if (extra != component.end() && extra->is_array()) {
+                    for (const auto &child : *extra)
+                        Component(child, style, depth + 1);
+                }
+            }
 
-        return out;
+            std::string Finish() {
+                if (format == TextFormat::Ansi) {
+                    out += ESC "[0m";
+                } else if (format == TextFormat::Html && current != Style()) {
+                    out += "</span>";
+                }
+                return std::move(out);
+            }
+
+          private:
+            TextFormat format;
+            const std::array<const char *, 256> &escapes;
+            std::string out;
+            Style current;
+
+            static void ApplyColor(Style &style, const std::string &color) {
+                if (color.size() == 7 && color[0] == '#') {
+                    char *end = nullptr;
+                    long rgb = std::strtol(color.c_str() + 1, &end, 16);
+                    if (end == color.c_str() + 7) {
+                        style.RGB = (int32_t)rgb;
+                        style.Color = ClosestColor(style.RGB);
+                    }
+                    return;
+                }
+
+                if (color == "reset") {
+                    style.Color = -1;
+                    style.RGB = -1;
+                    return;
+                }
+
+                for (int8_t i = 0; i < 16; ++i) {
+                    if (color == Palette[i].Name) {
+                        style.Color = i;
+                        style.RGB = -1;
+                        return;
+                    }
+                }
+            }
+
+            void Run(std::string_view text, const Style &style) {
+                if (text.empty())
+                    return;
+                if (style != current)
+                    SwitchStyle(style);
+
+                for (char c : text) {
+                    const char *escaped = escapes[(uint8_t)c];
+                    if (escaped == nullptr) {
+                        out.push_back(c);
+                    } else {
+                        out += escaped;
+                    }
+                }
+            }
+
+            void SwitchStyle(const Style &style) {
+                if (format == TextFormat::Ansi) {
+                    // one sequence from a clean slate, so nothing of the previous style lingers
+                    out += ESC "[0";
+                    if (style.RGB >= 0) {
+                        out += ";38;2;" + std::to_string((style.RGB >> 16) & 0xFF) + ";" +
+                               std::to_string((style.RGB >> 8) & 0xFF) + ";" + std::to_string(style.RGB & 0xFF);
+                    } else if (style.Color >= 0) {
+                        out += ';';
+                        out += Palette[style.Color].Ansi;
+                    }
+                    for (const StyleName &name : StyleNames) {
+                        if ((style.Flags & name.Flag) && name.Ansi != nullptr) {
+                            out += ';';
+                            out += name.Ansi;
+                        }
+                    }
+                    out += 'm';
+                } else if (format == TextFormat::Html) {
+                    if (current != Style())
+                        out += "</span>";
+                    if (style != Style()) {
+                        out += "<span class=\"";
+                        if (style.Color >= 0) {
+                            out += "mc-c";
+                            out += "0123456789abcdef"[style.Color];
+                        }
+                        for (const StyleName &name : StyleNames) {
+                            if (style.Flags & name.Flag) {
+                                if (out.back() != '"')
+                                    out += ' ';
+                                out += "mc-";
+                                out += name.Code;
+                            }
+                        }
+                        out += "\">";
+                    }
+                }
+
+                current = style;
+            }
+        };
+    }
+
+    std::string FormatText(std::string_view input, TextFormat format) {
+        Writer writer(format, input.size());
+        writer.Text(input, Style());
+        return writer.Finish();
+    }
+
+    std::string FormatChatComponent(const nlohmann::json &component, TextFormat format) {
+        Writer writer(format, 64);
+        writer.Component(component, Style(), 0);
+        return writer.Finish();
+    }
+
+    std::string EscapeToAnsi(const std::string &input) {
+        return FormatText(input, TextFormat::Ansi);
     }
 
 }
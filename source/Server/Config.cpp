@@ -37,14 +37,27 @@ DashsrvConfig::DashsrvConfig(const std::string &path) {
             port = 8080;
         }
 
+        workers = json.value("workers", 1);
+
+        localTTL = json.value("localttl", (uint64_t)5000);
+        meshTTL = json.value("meshttl", (uint64_t)5000);
+
+        stallBudget = json.value("stallbudget", (uint64_t)50);
+
         if (json.contains("servers") && json["servers"].is_array()) {
             for (const auto &servJson : json["servers"]) {
                 DashsrvConfigServer serverConfig;
                 serverConfig.type = servJson["type"];
                 if (serverConfig.type == "minecraft") {
-                    if (!servJson.contains("ip") || !servJson.contains("port") || !servJson.contains("version")) {
+                    // a query doesn't send a protocol version, only the Server List Ping needs one
+                    std::string probe = servJson.value("probe", "slp");
+                    if (!servJson.contains("ip") || !servJson.contains("port") ||
+                        (probe == "slp" && !servJson.contains("version"))) {
                         throw std::runtime_error("malformed config.json (in minecraft server type)");
                     }
+                    if (probe != "slp" && probe != "query") {
+                        throw std::runtime_error("malformed config.json (unknown minecraft probe '" + probe + "')");
+                    }
 
                     std::string extraDomain = "";
                     if (servJson.contains("extra-domain")) {
@@ -52,12 +65,28 @@ DashsrvConfig::DashsrvConfig(const std::string &path) {
                     }
 
                     std::string sip = servJson["ip"];
+                    int port = servJson["port"];
+                    std::string name = servJson.value("name", sip + ":" + std::to_string(port));
                     if (sip.ends_with(".local")) {
                         sip = ResolveMDNS(sip);
                     }
 
+                    for (const auto &other : servers) {
+                        if (other.type == "minecraft" &&
+                            std::get<DashsrvConfigServer::Minecraft>(other.server).name == name) {
+                            throw std::runtime_error("malformed config.json (duplicate minecraft server name '" +
+                                                     name + "')");
+                        }
+                    }
+
                     serverConfig.server = (DashsrvConfigServer::Minecraft){
-                        .ip = sip, .port = servJson["port"], .version = servJson["version"], .extraDomain = extraDomain
+                        .name = name,
+                        .ip = sip,
+                        .port = port,
+                        .version = servJson.value("version", 0),
+                        .extraDomain = extraDomain,
+                        .query = probe == "query",
+                        .queryPort = servJson.value("query-port", port),
                     };
                 } else if (serverConfig.type == "jellyfin") {
                     if (!servJson.contains("ip") || !servJson.contains("port")) {
@@ -81,10 +110,44 @@ DashsrvConfig::DashsrvConfig(const std::string &path) {
                     }
 
                     serverConfig.server = (DashsrvConfigServer::Dashboard){ .ip = sip, .port = servJson["port"] };
+                } else if (serverConfig.type == "tcp" || serverConfig.type == "http") {
+                    if (!servJson.contains("ip") || !servJson.contains("port")) {
+                        throw std::runtime_error("malformed config.json (in " + serverConfig.type + " server type)");
+                    }
+
+                    bool http = serverConfig.type == "http";
+                    std::string sip = servJson["ip"];
+                    int port = servJson["port"];
+                    std::string path = http ? servJson.value("path", "/") : "";
+                    std::string name = servJson.value("name", sip + ":" + std::to_string(port) + path);
+                    if (sip.ends_with(".local")) {
+                        sip = ResolveMDNS(sip);
+                    }
+
+                    for (const auto &other : servers) {
+                        if ((other.type == "tcp" || other.type == "http") &&
+                            std::get<DashsrvConfigServer::Check>(other.server).name == name) {
+                            throw std::runtime_error("malformed config.json (duplicate check name '" + name + "')");
+                        }
+                    }
+
+                    serverConfig.server = (DashsrvConfigServer::Check){
+                        .name = name,
+                        .ip = sip,
+                        .port = port,
+                        .path = path,
+                        .expectStatus = http ? servJson.value("expect-status", 0) : 0,
+                        .expectBody = http ? servJson.value("expect-body", "") : "",
+                        .timeout = servJson.value("timeout", (uint64_t)3000),
+                    };
                 } else {
                     throw std::runtime_error("malformed config.json (unknown server type '" + serverConfig.type + "')");
                 }
 
+                if (servJson.contains("ttl")) {
+                    serverConfig.ttl = servJson["ttl"];
+                }
+
                 servers.push_back(serverConfig);
             }
         }
@@ -0,0 +1,393 @@
+#include <Server/Core/AssetCache.h>
+
+#include <Basic.h>
+
+#include <mongoose.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef DASHSRV_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static constexpr uint64_t StreamThreshold = 256 * 1024;
+
+static std::string normalizeKey(const std::string &filepath) {
+    return fs::path(filepath).lexically_normal().generic_string();
+}
+
+static std::string formatHttpDate(fs::file_time_type ftime) {
+    using namespace std::chrono;
+    std::time_t t = system_clock::to_time_t(time_point_cast<system_clock::duration>(file_clock::to_sys(ftime)));
+
+    std::tm tm;
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+
+    char buf[64];
+    std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buf;
+}
+
+std::string computeETag(std::string_view content) {
+    mg_sha1_ctx ctx;
+    unsigned char digest[20];
+    mg_sha1_init(&ctx);
+    mg_sha1_update(&ctx, (const unsigned char *)content.data(), content.size());
+    mg_sha1_final(digest, &ctx);
+
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string etag = "\"";
+    for (unsigned char byte : digest) {
+        etag += hex[byte >> 4];
+        etag += hex[byte & 0x0F];
+    }
+    etag += "\"";
+    return etag;
+}
+
+static bool isCompressible(std::string_view contentType) {
+    return contentType.starts_with("text/") || contentType == "application/javascript" ||
+           contentType == "application/json" || contentType == "image/svg+xml";
+}
+
+static std::shared_ptr<const std::string> gzipCompress(const std::string &body) {
+#ifdef DASHSRV_HAS_ZLIB
+    z_stream stream{};
+    // 15 + 16 selects a gzip wrapper instead of raw zlib
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return nullptr;
+
+    std::string out(deflateBound(&stream, body.size()), '\0');
+    stream.next_in = (Bytef *)body.data();
+    stream.avail_in = (uInt)body.size();
+    stream.next_out = (Bytef *)out.data();
+    stream.avail_out = (uInt)out.size();
+
+    int rc = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (rc != Z_STREAM_END)
+        return nullptr;
+    return std::make_shared<const std::string>(std::move(out));
+#else
+    (void)body;
+    return nullptr;
+#endif
+}
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i]))
+            return false;
+    }
+    return true;
+}
+
+static std::string_view trimSpaces(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+// False for a q value of zero ("q=0", "q=0.000"), true when there is none.
+static bool acceptedByQuality(std::string_view params) {
+    size_t pos = 0;
+    while (pos < params.size()) {
+        size_t semi = params.find(';', pos);
+        if (semi == std::string_view::npos)
+            semi = params.size();
+
+        std::string_view param = trimSpaces(params.substr(pos, semi - pos));
+        pos = semi + 1;
+
+        if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') || param[1] != '=')
+            continue;
+
+        std::string_view qval = trimSpaces(param.substr(2));
+        while (!qval.empty() && (qval.front() == '0' || qval.front() == '.'))
+            qval.remove_prefix(1);
+        return !qval.empty() && qval.front() >= '1' && qval.front() <= '9';
+    }
+
+    return true;
+}
+
+bool acceptsGzip(std::string_view acceptEncoding) {
+    // every entry is looked at, an explicit gzip entry wins over * wherever either of them is
+    int gzip = -1, wildcard = -1;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t comma = acceptEncoding.find(',', pos);
+        if (comma == std::string_view::npos)
+            comma = acceptEncoding.size();
+
+        std::string_view coding = acceptEncoding.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        std::string_view params;
+        size_t semi = coding.find(';');
+        if (semi != std::string_view::npos) {
+            params = coding.substr(semi + 1);
+            coding = coding.substr(0, semi);
+        }
+        coding = trimSpaces(coding);
+
+        // content codings are case-insensitive
+        if (equalsIgnoreCase(coding, "gzip")) {
+            gzip = acceptedByQuality(params);
+        } else if (coding == "*") {
+            wildcard = acceptedByQuality(params);
+        }
+    }
+
+    if (gzip >= 0)
+        return gzip == 1;
+    return wildcard == 1;
+}
+
+std::string_view mimeTypeFor(std::string_view path) {
+    static const std::unordered_map<std::string_view, std::string_view> mimeTypes = {
+        { ".html", "text/html" },
+        { ".css", "text/css" },
+        { ".js", "application/javascript" },
+        { ".json", "application/json" },
+        { ".png", "image/png" },
+        { ".jpg", "image/jpeg" },
+        { ".jpeg", "image/jpeg" },
+        { ".gif", "image/gif" },
+        { ".svg", "image/svg+xml" },
+        { ".ico", "image/x-icon" },
+        { ".webp", "image/webp" },
+        { ".woff2", "font/woff2" },
+        { ".txt", "text/plain" },
+    };
+
+    size_t dot = path.rfind('.');
+    if (dot != std::string_view::npos) {
+        auto it = mimeTypes.find(path.substr(dot));
+        if (it != mimeTypes.end())
+            return it->second;
+    }
+
+    return "application/octet-stream";
+}
+
+AssetCache::AssetCache() {
+#ifdef __linux__
+    mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+AssetCache::~AssetCache() {
+#ifdef __linux__
+    if (mInotifyFd >= 0)
+        close(mInotifyFd);
+#endif
+}
+
+void AssetCache::preload(const std::string &root) {
+    std::error_code ec;
+    if (!fs::is_directory(root, ec))
+        return;
+
+    size_t loaded = 0, bytes = 0, compressed = 0, streamed = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(root, ec)) {
+        if (!entry.is_regular_file())
+            continue;
+
+        auto asset = find(entry.path().string());
+        if (asset) {
+            loaded++;
+            bytes += asset->body ? asset->body->size() : 0;
+            compressed += asset->gzip_body ? 1 : 0;
+            streamed += asset->streamed ? 1 : 0;
+        }
+    }
+
+    std::cout << "Cached " << loaded << " static assets (" << bytes / 1024 << " KiB, " << compressed
+              << " gzipped, " << streamed << " streamed from disk) from '" << root << "'\n";
+}
+
+std::shared_ptr<const StaticAsset> AssetCache::find(const std::string &filepath) {
+    checkInvalidations();
+
+    std::string key = normalizeKey(filepath);
+    {
+        std::shared_lock<std::shared_mutex> lock(mMutex);
+        auto it = mAssets.find(key);
+        if (it != mAssets.end())
+            return it->second;
+    }
+
+    auto asset = load(key);
+    if (!asset)
+        return nullptr;
+
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    mAssets[key] = asset;
+    return asset;
+}
+
+std::shared_ptr<const StaticAsset> AssetCache::load(const std::string &key) {
+    std::error_code ec;
+    if (!fs::is_regular_file(key, ec))
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mWatchMutex);
+        watch(fs::path(key).parent_path().generic_string());
+    }
+
+    auto asset = std::make_shared<StaticAsset>();
+    asset->path = key;
+    asset->mtime = fs::last_write_time(key, ec);
+    asset->size = fs::file_size(key, ec);
+    if (ec)
+        return nullptr;
+
+    asset->content_type = mimeTypeFor(key);
+    asset->last_modified = formatHttpDate(asset->mtime);
+
+    if (asset->size > StreamThreshold) {
+        // hashing would mean reading the whole file, size and mtime are enough to tell versions apart
+        char etag[64];
+        std::snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)asset->size,
+                      (unsigned long long)asset->mtime.time_since_epoch().count());
+        asset->etag = etag;
+        asset->streamed = true;
+        return asset;
+    }
+
+    try {
+        auto content = ReadFile(key);
+        if (!content)
+            return nullptr;
+        asset->body = std::make_shared<const std::string>(std::move(*content));
+    } catch (const std::exception &e) {
+        return nullptr;
+    }
+
+    asset->size = asset->body->size();
+    asset->etag = computeETag(*asset->body);
+
+    if (isCompressible(asset->content_type) && asset->body->size() > 256) {
+        auto compressed = gzipCompress(*asset->body);
+        if (compressed && compressed->size() < asset->body->size()) {
+            asset->gzip_body = compressed;
+            // each representation needs its own validator
+            asset->gzip_etag = asset->etag.substr(0, asset->etag.size() - 1) + "-gz\"";
+        }
+    }
+
+    return asset;
+}
+
+void AssetCache::watch(const std::string &dir) {
+#ifdef __linux__
+    if (mInotifyFd < 0)
+        return;
+
+    uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+    int wd = inotify_add_watch(mInotifyFd, dir.c_str(), mask);
+    if (wd >= 0)
+        mWatches[wd] = dir; // watching the same directory twice hands back the same descriptor
+#else
+    (void)dir;
+#endif
+}
+
+void AssetCache::checkInvalidations() {
+    // inotify events are drained a few times a second, mtimes rechecked once a second. Only the request that claims the
+    // slot checks, every other one goes on without a lock or a syscall.
+    uint64_t interval = 1000;
+#ifdef __linux__
+    if (mInotifyFd >= 0)
+        interval = 100;
+#endif
+    uint64_t now = GetTimeMillis();
+    uint64_t last = mLastCheckMS.load(std::memory_order_relaxed);
+    if (now - last < interval || !mLastCheckMS.compare_exchange_strong(last, now, std::memory_order_relaxed))
+        return;
+
+    std::vector<std::string> stale;
+    bool flushAll = false;
+
+#ifdef __linux__
+    if (mInotifyFd >= 0) {
+        std::lock_guard<std::mutex> lock(mWatchMutex);
+
+        alignas(struct inotify_event) char buf[4096];
+        ssize_t len;
+        while ((len = read(mInotifyFd, buf, sizeof(buf))) > 0) {
+            for (char *ptr = buf; ptr < buf + len;) {
+                const struct inotify_event *event = (const struct inotify_event *)ptr;
+                ptr += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    flushAll = true;
+                    continue;
+                }
+
+                auto it = mWatches.find(event->wd);
+                if (it == mWatches.end() || event->len == 0)
+                    continue;
+
+                std::string path = it->second + "/" + event->name;
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    watch(path);
+                }
+                stale.push_back(path);
+            }
+        }
+
+        if (stale.empty() && !flushAll)
+            return;
+    } else
+#endif
+    {
+        std::shared_lock<std::shared_mutex> lock(mMutex);
+        for (const auto &[key, asset] : mAssets) {
+            std::error_code ec;
+            if (fs::last_write_time(key, ec) != asset->mtime || ec)
+                stale.push_back(key);
+        }
+
+        if (stale.empty())
+            return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    if (flushAll) {
+        mAssets.clear();
+        return;
+    }
+
+    for (const auto &path : stale) {
+        mAssets.erase(path);
+
+        // a directory that was moved or deleted takes everything under it along
+        std::string prefix = path + "/";
+        std::erase_if(mAssets, [&](const auto &entry) { return entry.first.starts_with(prefix); });
+    }
+}
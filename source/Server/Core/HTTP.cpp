@@ -1,9 +1,10 @@
 #include <Server/Core/HTTP.h>
 
-#include <sstream>
+#include <mongoose.h>
+
 #include <string>
 
-HttpMethod parseHttpMethod(const std::string &method) {
+HttpMethod parseHttpMethod(std::string_view method) {
     if (method == "GET")
         return HttpMethod::GET;
     if (method == "POST")
@@ -25,19 +26,37 @@ HttpMethod parseHttpMethod(const std::string &method) {
     return HttpMethod::GET; // default fallback
 }
 
-std::unordered_map<std::string, std::string> parseQueryParams(const std::string &query) {
+bool urlDecode(std::string_view in, std::string &out, bool form) {
+    // decoding never makes the string longer, +1 for the terminator mg_url_decode writes
+    out.resize(in.size() + 1);
+    int len = mg_url_decode(in.data(), in.size(), out.data(), out.size(), form ? 1 : 0);
+    if (len < 0) {
+        out.clear();
+        return false;
+    }
+
+    out.resize((size_t)len);
+    return true;
+}
+
+std::unordered_map<std::string, std::string> parseQueryParams(std::string_view query) {
     std::unordered_map<std::string, std::string> params;
-    std::istringstream ss(query);
-    std::string token;
-    while (std::getline(ss, token, '&')) {
-        auto pos = token.find('=');
-        if (pos != std::string::npos) {
-            std::string key = token.substr(0, pos);
-            std::string value = token.substr(pos + 1);
-            params[key] = value;
-        } else {
-            params[token] = "";
-        }
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view token = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+
+        if (token.empty())
+            continue;
+
+        size_t eq = token.find('=');
+        std::string key, value;
+        if (!urlDecode(token.substr(0, eq), key, true))
+            continue;
+        if (eq != std::string_view::npos && !urlDecode(token.substr(eq + 1), value, true))
+            continue;
+
+        params[key] = value;
     }
     return params;
 }
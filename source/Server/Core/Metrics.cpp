@@ -0,0 +1,186 @@
+#include <Server/Core/Metrics.h>
+
+#include <algorithm>
+#include <cstdio>
+
+static constexpr std::initializer_list<double> LatencyBounds = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                                                 0.05,   0.1,   0.25,   0.5,   1,     2.5 };
+static constexpr std::initializer_list<double> PollBounds = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025,
+                                                              0.005,  0.01,    0.025,  0.05,  0.1 };
+
+static void appendNumber(std::string &out, double value) {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%g", value);
+    out.append(buf, n);
+}
+
+static void appendSample(std::string &out, const std::string &name, const std::string &labels, uint64_t value) {
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += std::to_string(value);
+    out += '\n';
+}
+
+static void appendHeader(std::string &out, const char *name, const char *type, const char *help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+Histogram::Histogram(std::initializer_list<double> bounds)
+    : mBounds(bounds), mCounts(std::make_unique<std::atomic<uint64_t>[]>(bounds.size() + 1)) {}
+
+void Histogram::observe(double seconds) {
+    size_t i = 0;
+    while (i < mBounds.size() && seconds > mBounds[i])
+        ++i;
+
+    mCounts[i].fetch_add(1, std::memory_order_relaxed);
+    mSumMicros.fetch_add((uint64_t)(seconds * 1e6), std::memory_order_relaxed);
+}
+
+void Histogram::render(std::string &out, const std::string &name, const std::string &labels) const {
+    std::string prefix = labels.empty() ? "" : labels + ",";
+
+    uint64_t total = 0;
+    for (size_t i = 0; i <= mBounds.size(); ++i) {
+        total += mCounts[i].load(std::memory_order_relaxed);
+
+        std::string le = prefix + "le=\"";
+        if (i < mBounds.size()) {
+            appendNumber(le, mBounds[i]);
+        } else {
+            le += "+Inf";
+        }
+        le += '"';
+        appendSample(out, name + "_bucket", le, total);
+    }
+
+    out += name + "_sum";
+    if (!labels.empty())
+        out += "{" + labels + "}";
+    out += ' ';
+    appendNumber(out, mSumMicros.load(std::memory_order_relaxed) / 1e6);
+    out += '\n';
+
+    appendSample(out, name + "_count", labels, total);
+}
+
+Metrics::RouteMetrics::RouteMetrics() : latency(LatencyBounds), statuses{} {}
+
+Metrics::Metrics() : mPollSeconds(PollBounds) {}
+
+void Metrics::addRoute(const std::string &route) {
+    std::lock_guard<std::mutex> lock(mRegistryMutex);
+    if (!mRoutes.contains(route))
+        mRoutes.emplace(route, std::make_unique<RouteMetrics>());
+}
+
+void Metrics::addCache(const std::string &name, const CacheStats *stats) {
+    std::lock_guard<std::mutex> lock(mRegistryMutex);
+    mCaches.emplace_back(name, stats);
+}
+
+size_t Metrics::statusSlot(int status) {
+    for (size_t i = 0; i < std::size(StatusCodes); ++i) {
+        if (StatusCodes[i] == status)
+            return i;
+    }
+    return StatusSlots - 1;
+}
+
+void Metrics::recordRequest(std::string_view route, int status, double seconds, bool reusedConnection) {
+    // no lock, routes are all registered before the first request comes in
+    auto it = route.empty() ? mRoutes.end() : mRoutes.find(route);
+    RouteMetrics &metrics = it != mRoutes.end() ? *it->second : mUnmatched;
+
+    metrics.latency.observe(seconds);
+    metrics.statuses[statusSlot(status)].fetch_add(1, std::memory_order_relaxed);
+
+    mRequests.fetch_add(1, std::memory_order_relaxed);
+    if (reusedConnection)
+        mReusedRequests.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string Metrics::render() const {
+    std::lock_guard<std::mutex> lock(mRegistryMutex);
+
+    std::vector<std::pair<std::string, const RouteMetrics *>> routes;
+    for (const auto &[route, metrics] : mRoutes) {
+        routes.emplace_back(route, metrics.get());
+    }
+    std::sort(routes.begin(), routes.end());
+    routes.emplace_back("unmatched", &mUnmatched);
+
+    std::string out;
+    out.reserve(8192);
+
+    appendHeader(out, "dashsrv_http_requests_total", "counter", "HTTP requests by route and status code.");
+    for (const auto &[route, metrics] : routes) {
+        for (size_t i = 0; i < StatusSlots; ++i) {
+            uint64_t count = metrics->statuses[i].load(std::memory_order_relaxed);
+            if (count == 0)
+                continue;
+
+            std::string code = i < std::size(StatusCodes) ? std::to_string(StatusCodes[i]) : "other";
+            appendSample(out, "dashsrv_http_requests_total", "route=\"" + route + "\",code=\"" + code + "\"", count);
+        }
+    }
+
+    appendHeader(out, "dashsrv_http_request_duration_seconds", "histogram",
+                 "Time from receiving a request to queueing its response.");
+    for (const auto &[route, metrics] : routes) {
+        metrics->latency.render(out, "dashsrv_http_request_duration_seconds", "route=\"" + route + "\"");
+    }
+
+    appendHeader(out, "dashsrv_http_received_bytes_total", "counter", "Bytes read from client connections.");
+    appendSample(out, "dashsrv_http_received_bytes_total", "", mBytesIn.load(std::memory_order_relaxed));
+    appendHeader(out, "dashsrv_http_sent_bytes_total", "counter", "Bytes written to client connections.");
+    appendSample(out, "dashsrv_http_sent_bytes_total", "", mBytesOut.load(std::memory_order_relaxed));
+
+    appendHeader(out, "dashsrv_http_open_connections", "gauge", "Open client connections, websockets included.");
+    appendSample(out, "dashsrv_http_open_connections", "",
+                 (uint64_t)std::max<int64_t>(0, mConnections.load(std::memory_order_relaxed)));
+    appendHeader(out, "dashsrv_websocket_open_connections", "gauge", "Open websocket connections.");
+    appendSample(out, "dashsrv_websocket_open_connections", "",
+                 (uint64_t)std::max<int64_t>(0, mWebsockets.load(std::memory_order_relaxed)));
+
+    uint64_t requests = mRequests.load(std::memory_order_relaxed);
+    uint64_t reused = mReusedRequests.load(std::memory_order_relaxed);
+    appendHeader(out, "dashsrv_http_keepalive_reused_requests_total", "counter",
+                 "Requests that arrived on an already used keep-alive connection.");
+    appendSample(out, "dashsrv_http_keepalive_reused_requests_total", "", reused);
+    appendHeader(out, "dashsrv_http_keepalive_reuse_ratio", "gauge",
+                 "Share of requests that reused a keep-alive connection.");
+    out += "dashsrv_http_keepalive_reuse_ratio ";
+    appendNumber(out, requests == 0 ? 0.0 : (double)reused / (double)requests);
+    out += '\n';
+
+    appendHeader(out, "dashsrv_cache_hits_total", "counter", "Reads served from a fresh cache snapshot.");
+    for (const auto &[name, stats] : mCaches) {
+        appendSample(out, "dashsrv_cache_hits_total", "cache=\"" + name + "\"",
+                     stats->hits.load(std::memory_order_relaxed));
+    }
+    appendHeader(out, "dashsrv_cache_misses_total", "counter", "Reads that found an empty or stale cache snapshot.");
+    for (const auto &[name, stats] : mCaches) {
+        appendSample(out, "dashsrv_cache_misses_total", "cache=\"" + name + "\"",
+                     stats->misses.load(std::memory_order_relaxed));
+    }
+
+    appendHeader(out, "dashsrv_poll_iteration_seconds", "histogram",
+                 "Time spent handling events per mg_mgr_poll() call, excluding the wait for I/O.");
+    mPollSeconds.render(out, "dashsrv_poll_iteration_seconds", "");
+
+    return out;
+}
@@ -6,9 +6,9 @@
 #include <string>
 
 std::string generate_guid() {
-    static std::random_device rd;
-    static std::mt19937_64 gen(rd());
-    static std::uniform_int_distribution<uint64_t> dis;
+    static thread_local std::random_device rd;
+    static thread_local std::mt19937_64 gen(rd());
+    static thread_local std::uniform_int_distribution<uint64_t> dis;
 
     uint64_t part1 = dis(gen);
     uint64_t part2 = dis(gen);
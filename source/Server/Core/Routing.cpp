@@ -0,0 +1,50 @@
+#include <Server/Core/Routing.h>
+
+#include <Server/Core/Metrics.h>
+
+#include <algorithm>
+
+void Router::add(HttpMethod method, const std::string &path, Handler handler) {
+    mRoutes[(size_t)method][path] = std::move(handler);
+    Metrics::get().addRoute(path);
+}
+
+void Router::mount(const std::string &prefix, Handler handler) {
+    mMounts.emplace_back(prefix, std::move(handler));
+    std::stable_sort(mMounts.begin(), mMounts.end(),
+                     [](const auto &a, const auto &b) { return a.first.size() > b.first.size(); });
+    Metrics::get().addRoute(prefix);
+}
+
+bool Router::dispatch(const RequestData &req, ResponseData &res) const {
+    for (HttpMethod method : { req.method, HttpMethod::GET }) {
+        const auto &routes = mRoutes[(size_t)method];
+        auto it = routes.find(std::string_view(req.path));
+        if (it != routes.end()) {
+            res.route = it->first;
+            it->second(req, res);
+            return true;
+        }
+
+        if (req.method != HttpMethod::HEAD)
+            break;
+    }
+
+    for (const auto &[prefix, handler] : mMounts) {
+        // "/static" covers "/static" and "/static/...", but not "/staticfoo"
+        if (req.path.starts_with(prefix) && (req.path.size() == prefix.size() || req.path[prefix.size()] == '/')) {
+            res.route = prefix;
+            handler(req, res);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string Router::prefixed(const std::string &path) const {
+    std::string full;
+    for (const auto &p : mPrefixes)
+        full += p;
+    return full + path;
+}
@@ -1,128 +1,417 @@
 #include <Server/Core/Server.h>
 
+#include <Server/Core/AssetCache.h>
 #include <Server/Core/HTTP.h>
+#include <Server/Core/Metrics.h>
 #include <Server/Core/Rand.h>
+#include <Server/Core/Watchdog.h>
 
 #include <Basic.h>
-#include <Hardware.h>
 
 #include <mongoose.h>
 
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
-#include <sstream>
 
 namespace fs = std::filesystem;
 
-std::string getMGEventString(int ev);
+// Builds the status line and headers in a per-thread buffer that keeps its capacity between responses.
+static const std::string &responseHead(const ResponseData &res, std::optional<uint64_t> contentLength) {
+    static thread_local std::string head;
+    head.clear();
+
+    char code[8];
+    auto end = std::to_chars(code, code + sizeof(code), res.status).ptr;
+
+    head += "HTTP/1.1 ";
+    head.append(code, end);
+    head += ' ';
+    head += mg_http_status_code_str(res.status);
+    head += "\r\n";
+    writeResponseHeaders(head, res, contentLength);
+    head += "\r\n";
+    return head;
+}
+
+// Queues head and body with a single reservation, so they sit contiguously in the send buffer and go out in one write.
+static void sendResponse(struct mg_connection *c, const std::string &head, const void *body, size_t bodyLen) {
+    size_t needed = c->send.len + head.size() + bodyLen;
+    if (c->send.size < needed)
+        mg_iobuf_resize(&c->send, needed);
 
-void mg_http_reply_nolen(struct mg_connection *c, int code, const std::string &headers, const void *body,
-                         size_t body_len) {
-    std::string resp =
-        "HTTP/1.1 " + std::to_string(code) + " " + mg_http_status_code_str(code) + "\r\n" + headers + "\r\n";
-    mg_send(c, resp.data(), resp.size());
-    if (body_len > 0 && body != nullptr) {
-        mg_send(c, body, body_len);
+    mg_send(c, head.data(), head.size());
+    if (bodyLen > 0 && body != nullptr) {
+        mg_send(c, body, bodyLen);
     }
     c->is_resp = 0;
 }
 
-void ev_handler(struct mg_connection *c, int ev, void *ev_data) {
-    NoreServer *server = (NoreServer *)c->fn_data;
-
-    if (ev != MG_EV_POLL) {
-        // std::cout << "Catching request " << getMGEventString(ev) << "\n";
+static bool etagListContains(struct mg_str list, std::string_view etag) {
+    std::string_view header(list.buf, list.len);
+    if (header == "*")
+        return true;
+
+    // If-None-Match uses weak comparison, so W/"x" matches "x"
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t comma = header.find(',', pos);
+        if (comma == std::string_view::npos)
+            comma = header.size();
+
+        std::string_view candidate = header.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        while (!candidate.empty() && candidate.front() == ' ')
+            candidate.remove_prefix(1);
+        while (!candidate.empty() && candidate.back() == ' ')
+            candidate.remove_suffix(1);
+        if (candidate.starts_with("W/"))
+            candidate.remove_prefix(2);
+
+        if (candidate == etag)
+            return true;
     }
 
-    if (ev == MG_EV_HTTP_MSG) {
-        struct mg_http_message *hm = (struct mg_http_message *)ev_data;
+    return false;
+}
 
-        RequestData req;
-        std::string method(hm->method.buf, hm->method.buf + hm->method.len);
-        req.method = parseHttpMethod(method);
+// Conditional GET: the client's copy is current when its validators match the ones the handler attached.
+static bool isNotModified(struct mg_http_message *hm, const ResponseData &res) {
+    if (res.status != 200)
+        return false;
 
-        req.url = std::string(hm->uri.buf, hm->uri.buf + hm->uri.len);
-        req.path = req.url;
-        if (hm->query.len > 0) {
-            req.query_string.assign(hm->query.buf, hm->query.len);
-            req.query_params = parseQueryParams(req.query_string);
+    if (res.cached && !res.cached->etag.empty()) {
+        if (struct mg_str *inm = mg_http_get_header(hm, "If-None-Match")) {
+            return etagListContains(*inm, res.cached->etag);
         }
+    }
 
-        if (req.url == "/ws") {
-            mg_ws_upgrade(c, hm, NULL);
-            return;
+    auto etag = res.headers.find("ETag");
+    if (etag != res.headers.end()) {
+        if (struct mg_str *inm = mg_http_get_header(hm, "If-None-Match")) {
+            std::string_view tag = etag->second;
+            if (tag.starts_with("W/"))
+                tag.remove_prefix(2);
+            return etagListContains(*inm, tag);
         }
+    }
 
-        for (size_t i = 0; i < MG_MAX_HTTP_HEADERS && hm->headers[i].name.len > 0; i++) {
-            std::string name(hm->headers[i].name.buf, hm->headers[i].name.buf + hm->headers[i].name.len);
-            std::string value(hm->headers[i].value.buf, hm->headers[i].value.buf + hm->headers[i].value.len);
-            req.headers[name] = value;
+    auto lastModified = res.headers.find("Last-Modified");
+    if (lastModified != res.headers.end()) {
+        if (struct mg_str *ims = mg_http_get_header(hm, "If-Modified-Since")) {
+            return std::string_view(ims->buf, ims->len) == lastModified->second;
         }
+    }
 
-        if (hm->body.len > 0) {
-            req.body.assign(hm->body.buf, hm->body.buf + hm->body.len);
-            req.content_length = hm->body.len;
-        }
+    return false;
+}
 
-        if (auto ct = mg_http_get_header(hm, "Content-Type")) {
-            req.content_type.assign(ct->buf, ct->len);
-        }
-        if (auto ua = mg_http_get_header(hm, "User-Agent")) {
-            req.user_agent.assign(ua->buf, ua->len);
-        }
-        if (auto cookie = mg_http_get_header(hm, "Cookie")) {
-            std::string cookiestr(cookie->buf, cookie->buf + cookie->len);
-
-            std::istringstream cs(cookiestr);
-            std::string kv;
-            while (std::getline(cs, kv, ';')) {
-                auto pos = kv.find('=');
-                if (pos != std::string::npos) {
-                    std::string key = kv.substr(0, pos);
-                    std::string value = kv.substr(pos + 1);
-                    req.cookies[key] = value;
-                }
-            }
-        }
+// Swaps in the precompressed variant of a static asset when the client accepts gzip.
+static void negotiateEncoding(struct mg_http_message *hm, ResponseData &res) {
+    if (!res.asset || !res.asset->gzip_body || res.status != 200)
+        return;
+
+    res.headers["Vary"] = "Accept-Encoding";
+
+    // byte ranges always refer to the identity encoding
+    if (mg_http_get_header(hm, "Range") != nullptr)
+        return;
+
+    struct mg_str *ae = mg_http_get_header(hm, "Accept-Encoding");
+    if (ae == nullptr || !acceptsGzip(std::string_view(ae->buf, ae->len)))
+        return;
+
+    res.shared_body = res.asset->gzip_body;
+    res.headers["ETag"] = res.asset->gzip_etag;
+    res.headers["Content-Encoding"] = "gzip";
+}
+
+// Parses a single "bytes=" range against a representation of the given size. Returns false when the range can't be
+// satisfied. Multiple ranges or units other than bytes leave start/length covering the whole representation.
+static bool parseRange(std::string_view header, uint64_t size, uint64_t &start, uint64_t &length) {
+    start = 0;
+    length = size;
+
+    if (!header.starts_with("bytes=") || header.find(',') != std::string_view::npos)
+        return true;
+    header.remove_prefix(6);
+
+    size_t dash = header.find('-');
+    if (dash == std::string_view::npos)
+        return true;
+
+    std::string_view first = header.substr(0, dash), last = header.substr(dash + 1);
+    uint64_t a = 0, b = 0;
+    bool hasFirst = !first.empty(), hasLast = !last.empty();
+    if (hasFirst && std::from_chars(first.data(), first.data() + first.size(), a).ec != std::errc())
+        return true;
+    if (hasLast && std::from_chars(last.data(), last.data() + last.size(), b).ec != std::errc())
+        return true;
+
+    if ((!hasFirst && !hasLast) || (hasFirst && hasLast && b < a))
+        return true; // malformed, ignored like any other range we don't understand
+
+    uint64_t end = size - 1;
+    if (!hasFirst) {
+        // "bytes=-N" asks for the last N bytes
+        if (b == 0 || size == 0)
+            return false;
+        start = b < size ? size - b : 0;
+    } else {
+        if (a >= size)
+            return false;
+        start = a;
+        if (hasLast && b < end)
+            end = b;
+    }
+
+    length = end - start + 1;
+    return true;
+}
+
+// If-Range: the range only applies while the client's copy is still the current one, otherwise it gets everything.
+static bool ifRangeMatches(struct mg_http_message *hm, const ResponseData &res) {
+    struct mg_str *ifRange = mg_http_get_header(hm, "If-Range");
+    if (ifRange == nullptr)
+        return true;
+
+    std::string_view value(ifRange->buf, ifRange->len);
+    if (value.starts_with("\""))
+        return res.headers.contains("ETag") && res.headers.at("ETag") == value; // strong comparison, W/ never matches
+    return res.headers.contains("Last-Modified") && res.headers.at("Last-Modified") == value;
+}
+
+// Narrows an asset response down to the requested byte range (206), or turns it into a 416 if the range lies outside.
+static void applyRange(struct mg_http_message *hm, ResponseData &res, uint64_t size, uint64_t &start,
+                       uint64_t &length) {
+    start = 0;
+    length = size;
+    if (!res.asset || res.status != 200)
+        return;
+
+    res.headers["Accept-Ranges"] = "bytes";
+
+    struct mg_str *range = mg_http_get_header(hm, "Range");
+    if (range == nullptr || !ifRangeMatches(hm, res))
+        return;
+
+    if (!parseRange(std::string_view(range->buf, range->len), size, start, length)) {
+        res.status = 416;
+        res.headers["Content-Range"] = "bytes */" + std::to_string(size);
+        start = length = 0;
+        return;
+    }
+
+    if (length == size)
+        return;
+
+    res.status = 206;
+    res.headers["Content-Range"] =
+        "bytes " + std::to_string(start) + "-" + std::to_string(start + length - 1) + "/" + std::to_string(size);
+}
+
+// Streams a file that's too large to keep in memory. Only about one chunk is read ahead of the socket, so memory per
+// download stays bounded whatever the file size; the rest is pulled from disk as MG_EV_WRITE reports progress.
+struct FileStream {
+    std::FILE *file;
+    uint64_t remaining;
+    bool closeAfter;
+};
+
+static constexpr size_t FileStreamChunk = 64 * 1024;
 
-        char addr[64];
-        mg_snprintf(addr, sizeof(addr), "%M", mg_print_ip, &c->rem);
-        req.remote_address = addr;
-        req.remote_port = c->rem.port;
+// c->data holds the active FileStream pointer, followed by the number of requests served on the connection.
+static constexpr size_t RequestCountOffset = sizeof(FileStream *);
 
-        req.scheme = c->is_tls ? "https" : "http";
-        req.is_secure = c->is_tls;
-        req.http_version = std::string(hm->proto.buf, hm->proto.buf + hm->proto.len);
-        if (auto host = mg_http_get_header(hm, "Host")) {
-            req.host.assign(host->buf, host->len);
+static FileStream *getFileStream(struct mg_connection *c) {
+    FileStream *stream;
+    std::memcpy(&stream, c->data, sizeof(stream));
+    return stream;
+}
+
+static void setFileStream(struct mg_connection *c, FileStream *stream) {
+    std::memcpy(c->data, &stream, sizeof(stream));
+}
+
+// Returns true if an earlier request already came in on this connection.
+static bool countRequest(struct mg_connection *c) {
+    uint32_t count;
+    std::memcpy(&count, c->data + RequestCountOffset, sizeof(count));
+    ++count;
+    std::memcpy(c->data + RequestCountOffset, &count, sizeof(count));
+    return count > 1;
+}
+
+static void endFileStream(struct mg_connection *c) {
+    FileStream *stream = getFileStream(c);
+    if (stream == nullptr)
+        return;
+
+    std::fclose(stream->file);
+    if (stream->closeAfter)
+        c->is_draining = 1;
+    delete stream;
+    setFileStream(c, nullptr);
+
+    c->is_resp = 0; // lets mongoose move on to the next pipelined request
+}
+
+static void pumpFileStream(struct mg_connection *c) {
+    FileStream *stream = getFileStream(c);
+    if (stream == nullptr || c->send.len >= FileStreamChunk)
+        return;
+
+    if (stream->remaining > 0) {
+        // read straight into the connection's send buffer, no intermediate strings
+        size_t want = (size_t)std::min<uint64_t>(FileStreamChunk, stream->remaining);
+        if (!mg_iobuf_resize(&c->send, c->send.len + want)) {
+            mg_error(c, "out of memory streaming file");
+            return;
         }
 
-        if (!req.host.empty()) {
-            auto dot = req.host.find('.');
-            if (dot != std::string::npos && dot < req.host.size() - 1) {
-                req.subdomain = req.host.substr(0, dot);
-                req.domain = req.host.substr(dot + 1);
-            }
+        size_t n = std::fread(c->send.buf + c->send.len, 1, want, stream->file);
+        c->send.len += n;
+        stream->remaining -= n;
+
+        if (n < want) {
+            // the file shrank underneath us, the promised Content-Length can't be met anymore
+            stream->remaining = 0;
+            stream->closeAfter = true;
         }
+    }
 
-        ResponseData res;
-        server->onRequest(req, res);
+    if (stream->remaining == 0)
+        endFileStream(c);
+}
+
+static bool startFileStream(struct mg_connection *c, struct mg_http_message *hm, const StaticAsset &asset,
+                            uint64_t start, uint64_t length) {
+    std::FILE *file = std::fopen(asset.path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    // reads go straight into the send buffer, stdio buffering would only add a copy
+    std::setvbuf(file, nullptr, _IONBF, 0);
+#ifdef _WIN32
+    int rc = _fseeki64(file, (__int64)start, SEEK_SET);
+#else
+    int rc = fseeko(file, (off_t)start, SEEK_SET);
+#endif
+    if (rc != 0) {
+        std::fclose(file);
+        return false;
+    }
+
+    struct mg_str *connection = mg_http_get_header(hm, "Connection");
+    bool closeAfter = connection != nullptr && mg_strcasecmp(*connection, mg_str("close")) == 0;
+
+    setFileStream(c, new FileStream{ file, length, closeAfter });
+    return true;
+}
+
+// Set by the first event of each mg_mgr_poll() call, i.e. once the wait for I/O is over, see runWorker. The slowest
+// handler call of the iteration is remembered for the watchdog.
+static thread_local bool tPollBusy = false;
+static thread_local StallWatchdog::Clock::time_point tPollBusySince;
+static thread_local StallWatchdog::Clock::duration tSlowestHandler;
+static thread_local int tSlowestEv;
+static thread_local std::string_view tSlowestRoute;
+
+static void respond(NoreServer *server, struct mg_connection *c, struct mg_http_message *hm, const RequestData &req,
+                    ResponseData &res) {
+    server->onRequest(req, res);
+
+    if (!res.handled) {
+        res.status = 404;
+        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "404 Not Found\n");
+        return;
+    }
+
+    negotiateEncoding(hm, res);
+
+    if (isNotModified(hm, res)) {
+        res.status = 304;
+        res.body.clear();
+        res.shared_body.reset();
+        sendResponse(c, responseHead(res, std::nullopt), nullptr, 0);
+        return;
+    }
+
+    std::string_view body = res.getBody();
+    uint64_t size = res.asset && res.asset->streamed ? res.asset->size : body.size();
+    uint64_t start, length;
+    applyRange(hm, res, size, start, length);
+
+    bool isHead = req.method == HttpMethod::HEAD;
+    bool stream = res.asset && res.asset->streamed && !isHead && (res.status == 200 || res.status == 206);
+    if (stream && !startFileStream(c, hm, *res.asset, start, length)) {
+        res.status = 500;
+        mg_http_reply(c, 500, "Content-Type: text/plain\r\n", "500 Internal Server Error\n");
+        return;
+    }
+
+    const std::string &head = responseHead(res, length);
+
+    if (stream) {
+        sendResponse(c, head, nullptr, 0);
+        c->is_resp = 1; // held until the last chunk is queued
+        pumpFileStream(c);
+        return;
+    }
+
+    body = isHead ? std::string_view() : body.substr(std::min<uint64_t>(start, body.size()), length);
+    sendResponse(c, head, body.data(), body.size());
+}
+
+// route is set for requests the router matched, so slow handlers can be traced back to it.
+void handleEvent(struct mg_connection *c, int ev, void *ev_data, std::string_view &route) {
+    NoreServer *server = (NoreServer *)c->fn_data;
+
+    if (ev != MG_EV_POLL) {
+        // std::cout << "Catching request " << getMGEventString(ev) << "\n";
+    }
+
+    if (ev == MG_EV_HTTP_MSG) {
+        struct mg_http_message *hm = (struct mg_http_message *)ev_data;
+        auto started = std::chrono::steady_clock::now();
+        bool reused = countRequest(c);
 
-        if (!res.handled) {
-            mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "404 Not Found\n", method.c_str(), req.url.c_str(),
-                          req.remote_address.c_str());
+        RequestData req(hm, c);
+
+        if (req.url == "/ws") {
+            mg_ws_upgrade(c, hm, NULL);
+            route = "/ws";
+            Metrics::get().recordRequest(route, 101, 0, reused);
             return;
         }
 
-        res.headers["Content-Length"] = std::to_string(res.body.size());
-        std::string headers = constructResponseHeaders(res);
-
-        mg_http_reply_nolen(c, res.status, headers, res.body.c_str(), res.body.size());
+        ResponseData res;
+        respond(server, c, hm, req, res);
+
+        route = res.route;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        Metrics::get().recordRequest(route, res.status, elapsed.count(), reused);
+    } else if (ev == MG_EV_WRITE || ev == MG_EV_POLL) {
+        if (ev == MG_EV_WRITE)
+            Metrics::get().addBytesOut((uint64_t)*(long *)ev_data);
+        pumpFileStream(c);
+    } else if (ev == MG_EV_READ) {
+        Metrics::get().addBytesIn((uint64_t)*(long *)ev_data);
+    } else if (ev == MG_EV_ACCEPT) {
+        Metrics::get().connectionOpened();
     } else if (ev == MG_EV_WS_OPEN) {
         std::string id = generate_guid();
-        server->mWSIds[c] = id;
-        server->mWSReverseLookup[id] = c;
+        {
+            std::lock_guard<std::mutex> lock(server->mWSMutex);
+            server->mWSIds[c] = id;
+            server->mWSReverseLookup[id] = { (NoreServer::Worker *)c->mgr->userdata, c, c->id };
+        }
+        Metrics::get().websocketOpened();
 
         if (server->mWSConnect) {
             server->mWSConnect(id);
@@ -131,16 +420,34 @@ void ev_handler(struct mg_connection *c, int ev, void *ev_data) {
         struct mg_ws_message *msg = (struct mg_ws_message *)ev_data;
         std::string msgstr(msg->data.buf, msg->data.buf + msg->data.len);
 
-        std::string id = server->mWSIds[c];
+        std::string id;
+        {
+            std::lock_guard<std::mutex> lock(server->mWSMutex);
+            id = server->mWSIds[c];
+        }
+
         if (server->mWSMessage) {
             server->mWSMessage(id, msgstr);
         }
 
+    } else if (ev == MG_EV_WAKEUP) {
+        if (c->is_listening) {
+            server->flushWebsocketOutbox(*(NoreServer::Worker *)c->mgr->userdata);
+        }
     } else if (ev == MG_EV_CLOSE) {
+        endFileStream(c);
+        if (c->is_accepted)
+            Metrics::get().connectionClosed();
+
         if (c->is_websocket) {
-            std::string id = server->mWSIds[c];
-            server->mWSIds.erase(c);
-            server->mWSReverseLookup.erase(id);
+            std::string id;
+            {
+                std::lock_guard<std::mutex> lock(server->mWSMutex);
+                id = server->mWSIds[c];
+                server->mWSIds.erase(c);
+                server->mWSReverseLookup.erase(id);
+            }
+            Metrics::get().websocketClosed();
 
             if (server->mWSClose) {
                 server->mWSClose(id);
@@ -149,9 +456,39 @@ void ev_handler(struct mg_connection *c, int ev, void *ev_data) {
     }
 }
 
-NoreServer::NoreServer(std::string address, std::function<bool(const RequestData &, ResponseData &)> handler) {
+// Every event goes through here so the watchdog sees how long each one took.
+static void ev_handler(struct mg_connection *c, int ev, void *ev_data) {
+    auto started = StallWatchdog::Clock::now();
+    if (!tPollBusy) {
+        tPollBusy = true;
+        tPollBusySince = started;
+        tSlowestHandler = StallWatchdog::Clock::duration::zero();
+    }
+
+    std::string_view route;
+    handleEvent(c, ev, ev_data, route);
+
+    auto finished = StallWatchdog::Clock::now();
+    StallWatchdog::get().recordHandler(ev, route, started, finished);
+    if (finished - started > tSlowestHandler) {
+        tSlowestHandler = finished - started;
+        tSlowestEv = ev;
+        tSlowestRoute = route;
+    }
+}
+
+NoreServer::NoreServer(std::string address, std::function<bool(const RequestData &, ResponseData &)> handler,
+                       int workers) {
     mHostAddress = address;
     mHandlerFunction = handler;
+    Metrics::get().addRoute("/ws"); // upgraded before the router sees it
+
+#if MG_ENABLE_SO_REUSEPORT
+    mWorkerCount = workers > 0 ? workers : 1;
+#else
+    mWorkerCount = 1; // no SO_REUSEPORT, so only one listener can own the port
+    (void)workers;
+#endif
 }
 
 bool NoreServer::onRequest(const RequestData &req, ResponseData &res) { return mHandlerFunction(req, res); }
@@ -159,20 +496,59 @@ bool NoreServer::onRequest(const RequestData &req, ResponseData &res) { return m
 void NoreServer::run() {
     mg_log_set(MG_LL_ERROR); // disable most mongoose logging
 
-    struct mg_mgr mgr;
-    mg_mgr_init(&mgr);
-    struct mg_connection *c = mg_http_listen(&mgr, mHostAddress.c_str(), ev_handler, this);
+    for (int i = 0; i < mWorkerCount; ++i) {
+        auto worker = std::make_unique<Worker>();
+        worker->server = this;
+        mWorkers.push_back(std::move(worker));
+    }
+
+    std::cout << "\nServer running on " << mHostAddress << " (" << mWorkerCount << " worker"
+              << (mWorkerCount == 1 ? "" : "s") << ")\n\n";
+
+    // the calling thread becomes the first worker
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < mWorkers.size(); ++i) {
+        threads.emplace_back(&NoreServer::runWorker, this, std::ref(*mWorkers[i]));
+    }
+    runWorker(*mWorkers[0]);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void NoreServer::runWorker(Worker &worker) {
+    worker.threadId = std::this_thread::get_id();
+
+    mg_mgr_init(&worker.mgr);
+    worker.mgr.userdata = &worker;
+    // only shared when there's more than one listener, otherwise a second instance on the port would start silently
+    worker.mgr.reuse_port = mWorkerCount > 1;
+    mg_wakeup_init(&worker.mgr);
+
+    worker.listener = mg_http_listen(&worker.mgr, mHostAddress.c_str(), ev_handler, this);
+    if (worker.listener == nullptr) {
+        std::cout << "Failed to listen on " << mHostAddress << "\n";
+        mg_mgr_free(&worker.mgr);
+        return;
+    }
 
     if (mHostAddress.starts_with("https://") || mHostAddress.starts_with("wss://")) {
         struct mg_tls_opts opts = { .cert = { (char *)"resources/server.crt", 20 },
                                     .key = { (char *)"resources/server.key", 20 } };
-        mg_tls_init(c, &opts);
+        mg_tls_init(worker.listener, &opts);
     }
 
-    std::cout << "\nServer running on " << mHostAddress << "\n\n";
     for (;;) {
-        gCPUUsage.Tick();
-        mg_mgr_poll(&mgr, 1000);
+        tPollBusy = false;
+        mg_mgr_poll(&worker.mgr, 1000);
+
+        if (tPollBusy) {
+            auto finished = StallWatchdog::Clock::now();
+            std::chrono::duration<double> busy = finished - tPollBusySince;
+            Metrics::get().recordPoll(busy.count());
+            StallWatchdog::get().recordPoll(tPollBusySince, finished, tSlowestEv, tSlowestRoute);
+        }
     }
 }
 
@@ -185,29 +561,155 @@ void NoreServer::attachWebsocketTools(std::function<void(const std::string &)> o
 }
 
 void NoreServer::sendToWebsocket(std::string id, const std::string &data) {
-    if (!mWSReverseLookup.contains(id))
-        return;
+    WSConnection ws;
+    {
+        std::lock_guard<std::mutex> lock(mWSMutex);
+        auto it = mWSReverseLookup.find(id);
+        if (it == mWSReverseLookup.end())
+            return;
+        ws = it->second;
+    }
 
-    struct mg_connection *c = mWSReverseLookup[id];
-    mg_ws_send(c, data.data(), data.size(), WEBSOCKET_OP_BINARY);
+    sendToWebsocket(ws, data);
 }
 
 void NoreServer::broadcastWebsockets(const std::string &data) {
-    for (const auto &[id, socket] : mWSReverseLookup) {
-        mg_ws_send(socket, data.data(), data.size(), WEBSOCKET_OP_BINARY);
+    std::vector<WSConnection> sockets;
+    {
+        std::lock_guard<std::mutex> lock(mWSMutex);
+        sockets.reserve(mWSReverseLookup.size());
+        for (const auto &[id, ws] : mWSReverseLookup) {
+            sockets.push_back(ws);
+        }
+    }
+
+    for (const auto &ws : sockets) {
+        sendToWebsocket(ws, data);
     }
 }
 
-std::string RequestData::getHeader(const std::string &key) const {
-    return headers.contains(key) ? headers.at(key) : "";
+void NoreServer::sendToWebsocket(const WSConnection &ws, const std::string &data) {
+    // connections may only be touched by the thread polling their manager
+    if (ws.worker->threadId == std::this_thread::get_id()) {
+        mg_ws_send(ws.conn, data.data(), data.size(), WEBSOCKET_OP_BINARY);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ws.worker->outboxMutex);
+        ws.worker->outbox.push_back({ ws.conn, ws.connId, data });
+    }
+
+    mg_wakeup(&ws.worker->mgr, ws.worker->listener->id, "", 0);
 }
 
-std::string RequestData::getQueryParam(const std::string &key) const {
-    return query_params.contains(key) ? query_params.at(key) : "";
+void NoreServer::flushWebsocketOutbox(Worker &worker) {
+    std::vector<WSOutgoing> outbox;
+    {
+        std::lock_guard<std::mutex> lock(worker.outboxMutex);
+        outbox.swap(worker.outbox);
+    }
+
+    std::lock_guard<std::mutex> lock(mWSMutex);
+    for (const auto &msg : outbox) {
+        // the connection may have closed (and its memory been reused) since the message was queued
+        auto it = mWSIds.find(msg.conn);
+        if (it == mWSIds.end() || msg.conn->id != msg.connId)
+            continue;
+
+        mg_ws_send(msg.conn, msg.data.data(), msg.data.size(), WEBSOCKET_OP_BINARY);
+    }
 }
 
-std::string RequestData::getCookie(const std::string &key) const {
-    return cookies.contains(key) ? cookies.at(key) : "";
+RequestData::RequestData(const struct mg_http_message *hm, const struct mg_connection *c) : message(hm) {
+    method = parseHttpMethod(std::string_view(hm->method.buf, hm->method.len));
+
+    url = std::string_view(hm->uri.buf, hm->uri.len);
+    path = url;
+    if (url.find('%') != std::string_view::npos) {
+        // an undecodable path or one hiding a NUL is left as sent, it won't match anything
+        if (urlDecode(url, decoded_path, false) && decoded_path.find('\0') == std::string::npos)
+            path = decoded_path;
+    }
+
+    query_string = std::string_view(hm->query.buf, hm->query.len);
+    body = std::string_view(hm->body.buf, hm->body.len);
+    content_length = hm->body.len;
+
+    remote = c->rem;
+    remote_port = mg_ntohs(c->rem.port);
+
+    scheme = c->is_tls ? "https" : "http";
+    is_secure = c->is_tls;
+    http_version = std::string_view(hm->proto.buf, hm->proto.len);
+}
+
+const struct mg_str *RequestData::findHeader(std::string_view key) const {
+    struct mg_str name = mg_str_n(key.data(), key.size());
+    for (size_t i = 0; i < MG_MAX_HTTP_HEADERS && message->headers[i].name.len > 0; i++) {
+        if (mg_strcasecmp(message->headers[i].name, name) == 0)
+            return &message->headers[i].value;
+    }
+    return nullptr;
+}
+
+std::string_view RequestData::getHeader(std::string_view key) const {
+    const struct mg_str *value = findHeader(key);
+    return value ? std::string_view(value->buf, value->len) : std::string_view();
+}
+
+bool RequestData::hasHeader(std::string_view key) const { return findHeader(key) != nullptr; }
+
+std::string_view RequestData::getQueryParam(const std::string &key) const {
+    if (!query_params)
+        query_params = parseQueryParams(query_string);
+
+    auto it = query_params->find(key);
+    return it != query_params->end() ? std::string_view(it->second) : std::string_view();
+}
+
+std::string_view RequestData::getCookie(std::string_view key) const {
+    if (!cookies) {
+        cookies.emplace();
+
+        std::string_view header = getHeader("Cookie");
+        while (!header.empty()) {
+            size_t semi = header.find(';');
+            std::string_view pair = header.substr(0, semi);
+            header = semi == std::string_view::npos ? std::string_view() : header.substr(semi + 1);
+
+            while (!pair.empty() && pair.front() == ' ')
+                pair.remove_prefix(1);
+
+            size_t eq = pair.find('=');
+            if (eq != std::string_view::npos)
+                cookies->emplace_back(pair.substr(0, eq), pair.substr(eq + 1));
+        }
+    }
+
+    for (const auto &[name, value] : *cookies) {
+        if (name == key)
+            return value;
+    }
+    return std::string_view();
+}
+
+std::string_view RequestData::getSubdomain() const {
+    std::string_view host = getHost();
+    size_t dot = host.find('.');
+    return dot != std::string_view::npos && dot < host.size() - 1 ? host.substr(0, dot) : std::string_view();
+}
+
+std::string_view RequestData::getDomain() const {
+    std::string_view host = getHost();
+    size_t dot = host.find('.');
+    return dot != std::string_view::npos && dot < host.size() - 1 ? host.substr(dot + 1) : std::string_view();
+}
+
+std::string RequestData::getRemoteAddress() const {
+    char addr[64];
+    mg_snprintf(addr, sizeof(addr), "%M", mg_print_ip, &remote);
+    return addr;
 }
 
 void ResponseData::setHeader(const std::string &key, const std::string &value) { headers[key] = value; }
@@ -226,7 +728,32 @@ void ResponseData::setBody(const std::string &b, const std::string &type) {
         content_type = type;
 }
 
-void ResponseData::respondDirectory(const std::string &dir, const std::string &part, const std::string &url) {
+void ResponseData::setSharedBody(std::shared_ptr<const std::string> b, const std::string &type) {
+    body.clear();
+    shared_body = std::move(b);
+    if (!type.empty())
+        content_type = type;
+}
+
+void ResponseData::setCachedBody(std::shared_ptr<const std::string> b, std::shared_ptr<const CachedHeaders> h) {
+    body.clear();
+    shared_body = std::move(b);
+    cached = std::move(h);
+}
+
+std::shared_ptr<const CachedHeaders> makeCachedHeaders(const std::string &contentType, std::string etag,
+                                                       uint64_t timing) {
+    auto headers = std::make_shared<CachedHeaders>();
+    headers->content_type = contentType;
+    headers->lines = "Cache-Control: no-cache\r\n";
+    if (!etag.empty())
+        headers->lines += "ETag: W/" + etag + "\r\n";
+    headers->etag = std::move(etag);
+    headers->timing = timing;
+    return headers;
+}
+
+void ResponseData::respondDirectory(const std::string &dir, const std::string &part, std::string_view url) {
     if (url.rfind(part, 0) != 0) {
         status = 404;
         setBody("404 Not Found", "text/plain");
@@ -234,7 +761,7 @@ void ResponseData::respondDirectory(const std::string &dir, const std::string &p
         return;
     }
 
-    std::string relative = url.substr(part.size());
+    std::string relative(url.substr(part.size()));
 
     if (relative.empty() || relative == "/") {
         relative = "/index.html";
@@ -249,95 +776,146 @@ void ResponseData::respondDirectory(const std::string &dir, const std::string &p
 
     fs::path fullPath = fs::path(dir) / relative.substr(1);
 
-    if (fs::is_directory(fullPath)) {
-        fullPath /= "index.html";
+    auto asset = AssetCache::get().find(fullPath.string());
+    if (!asset) {
+        asset = AssetCache::get().find((fullPath / "index.html").string());
     }
 
-    if (!fs::exists(fullPath) || !fs::is_regular_file(fullPath)) {
+    if (!asset) {
         status = 404;
         setBody("404 Not Found", "text/plain");
         handled = true;
         return;
     }
 
-    respondFile(fullPath.string());
+    respondAsset(asset);
 }
 
 void ResponseData::respondFile(const std::string &filepath) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) {
+    auto asset = AssetCache::get().find(filepath);
+    if (!asset) {
         status = 404;
         setBody("404 Not Found", "text/plain");
         handled = true;
         return;
     }
 
-    std::ostringstream ss;
-    ss << file.rdbuf();
-    body = ss.str();
+    respondAsset(asset);
+}
 
-    file.close();
+void ResponseData::respondAsset(const std::shared_ptr<const StaticAsset> &asset) {
+    this->asset = asset;
+    setSharedBody(asset->body, asset->content_type);
+    headers["ETag"] = asset->etag;
+    headers["Last-Modified"] = asset->last_modified;
 
-    if (filepath.ends_with(".html"))
-        content_type = "text/html";
-    else if (filepath.ends_with(".css"))
-        content_type = "text/css";
-    else if (filepath.ends_with(".js"))
-        content_type = "application/javascript";
-    else if (filepath.ends_with(".png"))
-        content_type = "image/png";
-    else if (filepath.ends_with(".jpg") || filepath.ends_with(".jpeg"))
-        content_type = "image/jpeg";
-    else if (filepath.ends_with(".txt"))
-        content_type = "text/plain";
-    else
-        content_type = "application/octet-stream";
+    // let browsers keep images around and revalidate them with the ETag instead of refetching
+    if (!content_type.starts_with("text/") && !headers.contains("Cache-Control")) {
+        headers["Cache-Control"] = "public, no-cache";
+    }
 
     status = 200;
     handled = true;
 }
 
-std::string getHttpDate() {
+// strftime only runs when the second changes, every other response on the thread reuses the formatted value
+static std::string_view cachedHttpDate() {
+    static thread_local std::time_t last = 0;
+    static thread_local char buf[64];
+    static thread_local size_t len = 0;
+
     std::time_t now = std::time(nullptr);
-    char buf[128];
-    std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", std::gmtime(&now));
-    return buf;
-}
+    if (now != last) {
+        std::tm tm;
+#ifdef _WIN32
+        gmtime_s(&tm, &now);
+#else
+        gmtime_r(&now, &tm);
+#endif
+        len = std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        last = now;
+    }
 
-std::string constructResponseHeaders(const ResponseData &res) {
-    std::stringstream ss;
+    return std::string_view(buf, len);
+}
 
-    ss << "Content-Type: " << (!res.content_type.empty() ? res.content_type : "text/plain; charset=utf-8") << "\r\n";
-    ss << "Connection: " << (res.keep_alive ? "keep-alive" : "close") << "\r\n";
-    ss << "Server: NoreServer/" DASHSRV_VERSION "\r\n";
-    ss << "Date: " << getHttpDate() << "\r\n";
+struct DefaultHeader {
+    std::string_view name;
+    std::string_view line;
+};
+
+static constexpr DefaultHeader SecurityHeaders[] = {
+    { "Content-Security-Policy", "Content-Security-Policy: default-src 'self'\r\n" },
+    { "Referrer-Policy", "Referrer-Policy: no-referrer\r\n" },
+    { "X-Frame-Options", "X-Frame-Options: SAMEORIGIN\r\n" },
+};
+
+void writeResponseHeaders(std::string &out, const ResponseData &res, std::optional<uint64_t> contentLength) {
+    std::string_view contentType = res.cached ? res.cached->content_type : res.content_type;
+    out += "Content-Type: ";
+    out += !contentType.empty() ? contentType : "text/plain; charset=utf-8";
+    out += res.keep_alive ? "\r\nConnection: keep-alive\r\n" : "\r\nConnection: close\r\n";
+    out += "Server: NoreServer/" DASHSRV_VERSION "\r\n";
+    out += "Date: ";
+    out += cachedHttpDate();
+    out += "\r\n";
+
+    if (contentLength) {
+        char len[24];
+        auto end = std::to_chars(len, len + sizeof(len), *contentLength).ptr;
+        out += "Content-Length: ";
+        out.append(len, end);
+        out += "\r\n";
+    }
 
-    std::unordered_map<std::string, std::string> headers = res.headers;
-    if (!headers.contains("Cache-Control")) {
-        if (res.content_type.starts_with("text/")) { // static endpoint
-            headers["Cache-Control"] = "public, max-age=86400";
-        } else {
-            headers["Cache-Control"] = "no-cache, no-store, must-revalidate";
+    // handler headers go first, the defaults then only fill in what they didn't set
+    bool hasCacheControl = false;
+    if (res.cached) {
+        out += res.cached->lines;
+        hasCacheControl = true;
+
+        if (res.cached->timing != 0) {
+            uint64_t now = GetTimeMillis();
+            uint64_t seconds = now > res.cached->timing ? (now - res.cached->timing) / 1000 : 0;
+            char age[24];
+            auto end = std::to_chars(age, age + sizeof(age), seconds).ptr;
+            out += "Age: ";
+            out.append(age, end);
+            out += "\r\n";
         }
     }
 
-    if (!headers.contains("Content-Security-Policy")) {
-        headers["Content-Security-Policy"] = "default-src 'self'";
-    }
+    bool overridden[std::size(SecurityHeaders)] = {};
+    for (const auto &[header, value] : res.headers) {
+        out += header;
+        out += ": ";
+        out += value;
+        out += "\r\n";
 
-    if (!headers.contains("Referrer-Policy")) {
-        headers["Referrer-Policy"] = "no-referrer";
+        hasCacheControl |= header == "Cache-Control";
+        for (size_t i = 0; i < std::size(SecurityHeaders); ++i) {
+            overridden[i] |= header == SecurityHeaders[i].name;
+        }
     }
 
-    if (!headers.contains("X-Frame-Options")) {
-        headers["X-Frame-Options"] = "SAMEORIGIN";
+    if (!hasCacheControl) {
+        if (res.content_type.starts_with("text/")) { // static endpoint
+            out += "Cache-Control: public, max-age=86400\r\n";
+        } else {
+            out += "Cache-Control: no-cache, no-store, must-revalidate\r\n";
+        }
     }
 
-    for (const auto &[header, value] : headers) {
-        ss << header << ": " << value << "\r\n";
+    for (size_t i = 0; i < std::size(SecurityHeaders); ++i) {
+        if (!overridden[i])
+            out += SecurityHeaders[i].line;
     }
+}
 
-    return ss.str();
+std::string constructResponseHeaders(const ResponseData &res) {
+    std::string out;
+    writeResponseHeaders(out, res, std::nullopt);
+    return out;
 }
 
 std::string getMGEventString(int ev) {
@@ -0,0 +1,141 @@
+#include <Server/Core/Watchdog.h>
+
+#include <Server/Core/Server.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <tuple>
+
+static uint64_t toSecond(StallWatchdog::Clock::time_point t) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch()).count();
+}
+
+static uint64_t toMicros(StallWatchdog::Clock::duration d) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+static void appendSeconds(std::string &out, uint64_t micros) {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%g", micros / 1e6);
+    out.append(buf, n);
+}
+
+void StallWatchdog::RollingMax::record(uint64_t micros, uint64_t second) {
+    Slot &slot = mSlots[second % WindowSeconds];
+
+    uint64_t seen = slot.second.load(std::memory_order_relaxed);
+    if (seen != second && slot.second.compare_exchange_strong(seen, second, std::memory_order_relaxed))
+        slot.micros.store(0, std::memory_order_relaxed);
+
+    uint64_t current = slot.micros.load(std::memory_order_relaxed);
+    while (micros > current && !slot.micros.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t StallWatchdog::RollingMax::max(uint64_t now) const {
+    uint64_t worst = 0;
+    for (const auto &slot : mSlots) {
+        if (now - slot.second.load(std::memory_order_relaxed) < WindowSeconds)
+            worst = std::max(worst, slot.micros.load(std::memory_order_relaxed));
+    }
+    return worst;
+}
+
+void StallWatchdog::recordHandler(int ev, std::string_view route, Clock::time_point started,
+                                  Clock::time_point finished) {
+    uint64_t micros = toMicros(finished - started);
+    uint64_t second = toSecond(finished);
+    mHandlerWorst.record(micros, second);
+
+    uint64_t budget = mBudgetMicros.load(std::memory_order_relaxed);
+    if (budget > 0 && micros > budget) {
+        mHandlerStalls.fetch_add(1, std::memory_order_relaxed);
+        report(false, ev, route, micros, second);
+    }
+}
+
+void StallWatchdog::recordPoll(Clock::time_point started, Clock::time_point finished, int slowestEv,
+                               std::string_view slowestRoute) {
+    uint64_t micros = toMicros(finished - started);
+    uint64_t second = toSecond(finished);
+    mPollWorst.record(micros, second);
+
+    uint64_t budget = mBudgetMicros.load(std::memory_order_relaxed);
+    if (budget > 0 && micros > budget) {
+        mPollStalls.fetch_add(1, std::memory_order_relaxed);
+        report(true, slowestEv, slowestRoute, micros, second);
+    }
+}
+
+void StallWatchdog::report(bool poll, int ev, std::string_view route, uint64_t micros, uint64_t second) {
+    // built up front so lines from different workers don't interleave
+    std::string line = poll ? "Stall: poll iteration took " : "Stall: handler took ";
+    char ms[32];
+    std::snprintf(ms, sizeof(ms), "%.1fms", micros / 1000.0);
+    line += ms;
+    line += poll ? " (slowest event: " : " (event: ";
+    line += getMGEventString(ev);
+    if (!route.empty()) {
+        line += ", route: ";
+        line += route;
+    }
+    line += ", budget: " + std::to_string(getBudget()) + "ms)\n";
+    std::cout << line << std::flush;
+
+    std::lock_guard<std::mutex> lock(mReportsMutex);
+    mReports.push_back({ second, poll, ev, std::string(route), micros });
+    while (mReports.size() > MaxReports) {
+        mReports.pop_front();
+    }
+}
+
+void StallWatchdog::render(std::string &out) const {
+    uint64_t now = toSecond(Clock::now());
+
+    out += "# HELP dashsrv_handler_worst_seconds Slowest event handler call in the last minute.\n"
+           "# TYPE dashsrv_handler_worst_seconds gauge\n"
+           "dashsrv_handler_worst_seconds ";
+    appendSeconds(out, mHandlerWorst.max(now));
+    out += "\n# HELP dashsrv_poll_worst_seconds Slowest mg_mgr_poll() iteration in the last minute.\n"
+           "# TYPE dashsrv_poll_worst_seconds gauge\n"
+           "dashsrv_poll_worst_seconds ";
+    appendSeconds(out, mPollWorst.max(now));
+
+    out += "\n# HELP dashsrv_stall_budget_seconds How long a handler call or poll iteration may take before it's "
+           "reported.\n"
+           "# TYPE dashsrv_stall_budget_seconds gauge\n"
+           "dashsrv_stall_budget_seconds ";
+    appendSeconds(out, mBudgetMicros.load(std::memory_order_relaxed));
+
+    out += "\n# HELP dashsrv_stalls_total Handler calls and poll iterations that went over the budget.\n"
+           "# TYPE dashsrv_stalls_total counter\n";
+    out += "dashsrv_stalls_total{kind=\"handler\"} " +
+           std::to_string(mHandlerStalls.load(std::memory_order_relaxed)) + "\n";
+    out += "dashsrv_stalls_total{kind=\"poll\"} " + std::to_string(mPollStalls.load(std::memory_order_relaxed)) + "\n";
+
+    // worst recent stall per event and route, this is what points at the culprit
+    std::map<std::tuple<bool, int, std::string>, uint64_t> worst;
+    {
+        std::lock_guard<std::mutex> lock(mReportsMutex);
+        for (const auto &r : mReports) {
+            if (now - r.second >= WindowSeconds)
+                continue;
+
+            uint64_t &micros = worst[{ r.poll, r.ev, r.route }];
+            micros = std::max(micros, r.micros);
+        }
+    }
+
+    out += "# HELP dashsrv_stall_worst_seconds Worst stall in the last minute by event and route.\n"
+           "# TYPE dashsrv_stall_worst_seconds gauge\n";
+    for (const auto &[key, micros] : worst) {
+        const auto &[poll, ev, route] = key;
+        out += "dashsrv_stall_worst_seconds{kind=\"";
+        out += poll ? "poll" : "handler";
+        out += "\",event=\"" + getMGEventString(ev) + "\",route=\"" + route + "\"} ";
+        appendSeconds(out, micros);
+        out += '\n';
+    }
+}
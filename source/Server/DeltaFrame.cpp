@@ -0,0 +1,183 @@
+#include <Server/DeltaFrame.h>
+
+#include <cstring>
+
+namespace DeltaFrame {
+
+enum ValueType : uint8_t {
+    Null = 0,
+    False = 1,
+    True = 2,
+    SignedInt = 3,
+    UnsignedInt = 4,
+    Double = 5,
+    String = 6,
+    EmptyArray = 7,
+    EmptyObject = 8,
+};
+
+static void writeVarint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out += (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+static void writeString(std::string &out, const std::string &str) {
+    writeVarint(out, str.size());
+    out += str;
+}
+
+static void writeValue(std::string &out, const nlohmann::json &value) {
+    switch (value.type()) {
+    case nlohmann::json::value_t::boolean:
+        out += (char)(value.get<bool>() ? True : False);
+        break;
+    case nlohmann::json::value_t::number_integer: {
+        int64_t v = value.get<int64_t>();
+        out += (char)SignedInt;
+        writeVarint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+        break;
+    }
+    case nlohmann::json::value_t::number_unsigned:
+        out += (char)UnsignedInt;
+        writeVarint(out, value.get<uint64_t>());
+        break;
+    case nlohmann::json::value_t::number_float: {
+        double v = value.get<double>();
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+
+        out += (char)Double;
+        for (int i = 0; i < 8; ++i) {
+            out += (char)((bits >> (i * 8)) & 0xFF);
+        }
+        break;
+    }
+    case nlohmann::json::value_t::string:
+        out += (char)String;
+        writeString(out, value.get_ref<const std::string &>());
+        break;
+    case nlohmann::json::value_t::array:
+        out += (char)EmptyArray;
+        break;
+    case nlohmann::json::value_t::object:
+        out += (char)EmptyObject;
+        break;
+    default:
+        out += (char)Null;
+        break;
+    }
+}
+
+TopicHistory::TopicHistory(std::string topic, size_t depth) : mTopic(std::move(topic)), mDepth(depth) {}
+
+uint32_t TopicHistory::push(const nlohmann::json &document) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Version next{ mVersions.empty() ? 1 : mVersions.back().number + 1, {} };
+    flatten(document, "", next.fields);
+
+    mVersions.push_back(std::move(next));
+    while (mVersions.size() > mDepth) {
+        mVersions.pop_front();
+    }
+
+    return mVersions.back().number;
+}
+
+uint32_t TopicHistory::version() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mVersions.empty() ? 0 : mVersions.back().number;
+}
+
+std::string TopicHistory::encode(uint32_t baseVersion) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    static const Fields empty;
+    const Fields &current = mVersions.empty() ? empty : mVersions.back().fields;
+    uint32_t version = mVersions.empty() ? 0 : mVersions.back().number;
+
+    const Fields *base = nullptr;
+    for (const auto &v : mVersions) {
+        if (v.number == baseVersion) {
+            base = &v.fields;
+            break;
+        }
+    }
+
+    std::vector<uint32_t> defs, sets, removals;
+    for (const auto &[id, value] : current) {
+        auto prev = base ? base->find(id) : empty.end();
+        if (base == nullptr || prev == base->end()) {
+            // the client has never seen this field at its base version, so it may not know the name either
+            defs.push_back(id);
+            sets.push_back(id);
+        } else if (prev->second != value) {
+            sets.push_back(id);
+        }
+    }
+
+    if (base != nullptr) {
+        for (const auto &[id, value] : *base) {
+            if (!current.contains(id))
+                removals.push_back(id);
+        }
+    }
+
+    std::string out;
+    out += (char)(base ? Delta : Full);
+    out += (char)mTopic.size();
+    out += mTopic;
+    writeVarint(out, base ? baseVersion : 0);
+    writeVarint(out, version);
+
+    writeVarint(out, defs.size());
+    for (uint32_t id : defs) {
+        writeVarint(out, id);
+        writeString(out, mNames[id]);
+    }
+
+    writeVarint(out, sets.size());
+    for (uint32_t id : sets) {
+        writeVarint(out, id);
+        writeValue(out, current.at(id));
+    }
+
+    writeVarint(out, removals.size());
+    for (uint32_t id : removals) {
+        writeVarint(out, id);
+    }
+
+    return out;
+}
+
+uint32_t TopicHistory::fieldId(const std::string &path) {
+    auto it = mIds.find(path);
+    if (it != mIds.end())
+        return it->second;
+
+    uint32_t id = (uint32_t)mNames.size();
+    mNames.push_back(path);
+    mIds[path] = id;
+    return id;
+}
+
+void TopicHistory::flatten(const nlohmann::json &value, const std::string &path, Fields &out) {
+    std::string prefix = path.empty() ? "" : path + ".";
+
+    if (value.is_object() && !value.empty()) {
+        for (const auto &[key, child] : value.items()) {
+            flatten(child, prefix + key, out);
+        }
+    } else if (value.is_array() && !value.empty()) {
+        for (size_t i = 0; i < value.size(); ++i) {
+            flatten(value[i], prefix + std::to_string(i), out);
+        }
+    } else {
+        out[fieldId(path)] = value;
+    }
+}
+
+} // namespace DeltaFrame
@@ -0,0 +1,242 @@
+#include <Server/HealthChecks.h>
+
+#include <Basic.h>
+
+#include <mongoose.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string_view>
+
+static constexpr size_t MaxResponseBytes = 1 << 20; // enough for any health endpoint, bigger answers count as down
+
+static double millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Checks an http response collected so far. Returns false while more of it is expected.
+static bool evaluateResponse(const HealthCheckTarget &target, const mg_iobuf &recv, bool closed, bool &up,
+                             std::string &error, int &status) {
+    struct mg_http_message hm;
+    int n = mg_http_parse((const char *)recv.buf, recv.len, &hm);
+    if (n < 0) {
+        up = false;
+        error = "malformed HTTP response";
+        return true;
+    }
+
+    if (n == 0) {
+        if (!closed)
+            return false;
+        up = false;
+        error = recv.len == 0 ? "connection closed without a response" : "incomplete HTTP response";
+        return true;
+    }
+
+    // the request asks for Connection: close, so without a Content-Length the body ends when the connection does
+    std::string_view body((const char *)recv.buf + n, recv.len - n);
+    struct mg_str *contentLength = mg_http_get_header(&hm, "Content-Length");
+    if (contentLength != nullptr) {
+        size_t length = std::strtoull(std::string(contentLength->buf, contentLength->len).c_str(), nullptr, 10);
+        if (body.size() < length) {
+            if (!closed)
+                return false;
+            up = false;
+            error = "incomplete HTTP response";
+            return true;
+        }
+        body = body.substr(0, length);
+    } else if (!closed) {
+        return false;
+    }
+
+    status = mg_http_status(&hm);
+    if (target.ExpectStatus != 0 ? status != target.ExpectStatus : status >= 400) {
+        up = false;
+        error = "unexpected status " + std::to_string(status);
+    } else if (!target.ExpectBody.empty() && body.find(target.ExpectBody) == std::string_view::npos) {
+        up = false;
+        error = "body does not contain the expected text";
+    } else {
+        up = true;
+    }
+
+    return true;
+}
+
+void check_ev_handler(struct mg_connection *c, int ev, void *ev_data) {
+    using Attempt = HealthCheckEngine::Attempt;
+    Attempt *attempt = static_cast<Attempt *>(c->fn_data);
+    HealthCheckEngine *engine = attempt->Engine;
+    const HealthCheckTarget &target = engine->mTargets[attempt->Index];
+
+    switch (ev) {
+    case MG_EV_CONNECT: {
+        attempt->ConnectMS = millisSince(attempt->Started);
+        if (!target.HTTP) {
+            engine->finish(attempt, true, "");
+            c->is_draining = 1;
+            break;
+        }
+
+        mg_printf(c,
+                  "GET %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: dashsrv\r\nAccept: */*\r\nConnection: close\r\n\r\n",
+                  target.Path.c_str(), target.IP.c_str(), target.Port);
+        break;
+    }
+    case MG_EV_READ: {
+        if (attempt->FirstByteMS < 0)
+            attempt->FirstByteMS = millisSince(attempt->Started);
+        if (attempt->Finished || !target.HTTP) {
+            c->recv.len = 0;
+            break;
+        }
+
+        if (c->recv.len > MaxResponseBytes) {
+            engine->finish(attempt, false, "response too large");
+            c->is_closing = 1;
+            break;
+        }
+
+        bool up;
+        int status = 0;
+        std::string error;
+        if (evaluateResponse(target, c->recv, false, up, error, status)) {
+            engine->finish(attempt, up, error, status);
+            c->is_draining = 1;
+        }
+        break;
+    }
+    case MG_EV_ERROR: {
+        attempt->Error = (const char *)ev_data;
+        break;
+    }
+    case MG_EV_CLOSE: {
+        if (!attempt->Finished) {
+            bool up = false;
+            int status = 0;
+            std::string error = attempt->Error;
+            if (target.HTTP && attempt->ConnectMS >= 0) {
+                evaluateResponse(target, c->recv, true, up, error, status);
+            } else if (error.empty()) {
+                error = "connection closed";
+            }
+            engine->finish(attempt, up, error, status);
+        }
+
+        engine->mAttempts[attempt->Index].reset();
+        break;
+    }
+    }
+}
+
+HealthCheckEngine::~HealthCheckEngine() { stop(); }
+
+void HealthCheckEngine::addCheck(const HealthCheckTarget &target) {
+    HealthCheckStatus status;
+    status.Name = target.Name;
+    status.Type = target.HTTP ? "http" : "tcp";
+    status.Target = target.IP + ":" + std::to_string(target.Port) + (target.HTTP ? target.Path : "");
+
+    mTargets.push_back(target);
+    mStatuses.push_back(status);
+}
+
+void HealthCheckEngine::start(Listener listener) {
+    mListener = std::move(listener);
+    mStopping = false;
+    mThread = std::thread(&HealthCheckEngine::run, this);
+}
+
+void HealthCheckEngine::stop() {
+    mStopping = true;
+    if (mThread.joinable())
+        mThread.join();
+}
+
+void HealthCheckEngine::run() {
+    std::mt19937_64 gen(std::random_device{}());
+
+    // the first round is spread over a second, so hundreds of checks don't all connect in the same instant
+    Clock::time_point now = Clock::now();
+    mNextDue.assign(mTargets.size(), now);
+    mAttempts.clear();
+    mAttempts.resize(mTargets.size());
+    std::uniform_int_distribution<int64_t> spread(0, 1000);
+    for (auto &due : mNextDue) {
+        due += std::chrono::milliseconds(spread(gen));
+    }
+
+    mg_mgr mgr;
+    mg_mgr_init(&mgr);
+
+    while (!mStopping) {
+        now = Clock::now();
+        for (size_t i = 0; i < mTargets.size(); ++i) {
+            Attempt *attempt = mAttempts[i].get();
+            if (attempt == nullptr) {
+                if (now < mNextDue[i])
+                    continue;
+
+                int64_t interval = (int64_t)mTargets[i].IntervalMS;
+                std::uniform_int_distribution<int64_t> jitter(-interval / 10, interval / 10);
+                mNextDue[i] = now + std::chrono::milliseconds(interval + jitter(gen));
+                begin(&mgr, i, now);
+            } else if (!attempt->Finished &&
+                       now - attempt->Started > std::chrono::milliseconds(mTargets[i].TimeoutMS)) {
+                finish(attempt, false, "timed out");
+                attempt->Conn->is_closing = 1;
+            }
+        }
+
+        mg_mgr_poll(&mgr, 20);
+
+        if (mChanged) {
+            mChanged = false;
+            try {
+                mListener(mStatuses);
+            } catch (const std::exception &e) {
+                std::cout << "Health check listener failed: " << e.what() << "\n";
+            }
+        }
+    }
+
+    mg_mgr_free(&mgr);
+    mAttempts.clear();
+}
+
+void HealthCheckEngine::begin(struct mg_mgr *mgr, size_t index, Clock::time_point now) {
+    const HealthCheckTarget &target = mTargets[index];
+
+    auto attempt = std::make_unique<Attempt>();
+    attempt->Engine = this;
+    attempt->Index = index;
+    attempt->Started = now;
+
+    std::string url = "tcp://" + target.IP + ":" + std::to_string(target.Port);
+    attempt->Conn = mg_connect(mgr, url.c_str(), check_ev_handler, attempt.get());
+    if (attempt->Conn == nullptr) {
+        finish(attempt.get(), false, "could not connect");
+        return;
+    }
+
+    mAttempts[index] = std::move(attempt);
+}
+
+void HealthCheckEngine::finish(Attempt *attempt, bool up, const std::string &error, int status) {
+    if (attempt->Finished)
+        return;
+    attempt->Finished = true;
+
+    HealthCheckStatus &result = mStatuses[attempt->Index];
+    result.Checked = true;
+    result.Up = up;
+    result.Error = up ? "" : error;
+    result.Status = status;
+    result.ConnectMS = attempt->ConnectMS;
+    result.FirstByteMS = attempt->FirstByteMS;
+    result.TotalMS = millisSince(attempt->Started);
+    result.CheckedAt = GetTimeMillis();
+    mChanged = true;
+}
@@ -0,0 +1,57 @@
+#include <Server/ProbeScheduler.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+ProbeScheduler::~ProbeScheduler() { stop(); }
+
+void ProbeScheduler::addProbe(const std::string &name, uint64_t intervalMS, std::function<void()> probe) {
+    mProbes.push_back({ name, intervalMS, probe });
+}
+
+void ProbeScheduler::start() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = false;
+    }
+
+    for (const auto &probe : mProbes) {
+        mThreads.emplace_back(&ProbeScheduler::runProbe, this, std::cref(probe));
+    }
+}
+
+void ProbeScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mStopSignal.notify_all();
+
+    for (auto &thread : mThreads) {
+        if (thread.joinable())
+            thread.join();
+    }
+    mThreads.clear();
+}
+
+void ProbeScheduler::runProbe(const Probe &probe) {
+    std::mt19937_64 gen(std::random_device{}());
+    int64_t jitterMS = (int64_t)probe.intervalMS / 10;
+    std::uniform_int_distribution<int64_t> jitter(-jitterMS, jitterMS);
+
+    for (;;) {
+        try {
+            probe.fn();
+        } catch (const std::exception &e) {
+            std::cout << "Probe '" << probe.name << "' failed: " << e.what() << "\n";
+        }
+
+        auto wait = std::chrono::milliseconds((int64_t)probe.intervalMS + jitter(gen));
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mStopSignal.wait_for(lock, wait, [this] { return mStopping; })) {
+            return;
+        }
+    }
+}
@@ -2,158 +2,305 @@
 
 #include <Server/CacheContainer.h>
 #include <Server/Config.h>
+#include <Server/Core/Metrics.h>
 #include <Server/Core/Routing.h>
+#include <Server/Core/Watchdog.h>
+#include <Server/HealthChecks.h>
+#include <Server/ProbeScheduler.h>
+#include <Server/Statuses.h>
 
+#include <Minecraft/GameSpy.h>
 #include <Minecraft/MCDef.h>
 #include <Minecraft/Status.h>
 
 #include <Hardware.h>
 #include <MGClient.h>
 
+#include <mongoose.h>
 #include <nlohmann/json.hpp>
 
+#include <atomic>
 #include <cmath>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
-
-struct JellyfinStatus {
-    bool Online;
-    std::string Health;
-
-    std::string LocalAddress;
-    std::string ServerName;
-    std::string Version;
-    std::string ProductName;
-    std::string OperatingSystem;
-    std::string ID;
-    bool StartupWizardComplete;
+#include <unordered_map>
+#include <unordered_set>
+
+static CacheContainer<MinecraftNetworkStatus> ServerCache(10000, "mc");
+static CacheContainer<JellyfinStatus> JellyfinCache(30000, "jellyfin");
+static CacheContainer<DashboardStatus> HardwareCache(5000, "local");
+static CacheContainer<DashboardHealthStatus> MeshCache(5000, "mesh");
+static CacheContainer<HealthCheckReport> ChecksCache(10000, "checks");
+
+struct PeerStatus {
+    std::string ETag;
+    DashboardStatus Status;
 };
 
-struct DashboardStatus {
-    std::vector<std::string> IPs;
-    struct {
-        uint64_t Available;
-        uint64_t Total;
-    } Memory;
-    double CPU;
-    uint64_t Ping;
-    bool IsCurrent;
-    bool Online;
-};
+static std::unordered_map<std::string, PeerStatus> PeerStatuses; // last full answer of each peer, mesh probe only
 
-struct DashboardHealthStatus {
-    std::vector<DashboardStatus> Statuses;
-};
+static std::atomic<double> LastValidCPUUsage = 0.0;
 
-static CacheContainer<Minecraft::MCStatus, 10000> ServerCache;
-static CacheContainer<JellyfinStatus, 30000> JellyfinCache;
-static CacheContainer<DashboardStatus, 5000> HardwareCache;
-static CacheContainer<DashboardHealthStatus, 5000> MeshCache;
+// Loaded on first use rather than during static initialization, so linking this file (e.g. into dashsrv_bench) doesn't
+// read or create resources/config.json.
+static const DashsrvConfig &dashConfig() {
+    static const DashsrvConfig config("resources/config.json");
+    return config;
+}
 
-static double LastValidCPUUsage = 0.0;
+static DashsrvConfigServer *JellyfinInfo;
 
-static const DashsrvConfig DashConfig("resources/config.json");
-static DashsrvConfigServer *MinecraftInfo, *JellyfinInfo;
+// Every configured Minecraft server in config order, with its own snapshot for /api/mc/{name}. ServerCache holds the
+// list built from these.
+static std::vector<const DashsrvConfigServer *> MinecraftInfos;
+static std::vector<std::unique_ptr<CacheContainer<MinecraftServerStatus>>> MinecraftCaches;
+// servers with different ttls are probed, and rebuild the list, on their own threads
+static std::mutex MinecraftListMutex;
 
+// Server icons are decoded once per change and served by hash from /api/mc/icon/{hash}, so the JSON only carries the
+// hash and browsers can cache the image for good. Only the icons some server currently has are kept.
+struct MinecraftIcon {
+    std::string Favicon; // the data url the hash was made from, an unchanged favicon isn't decoded again
+    std::string Hash;
+};
+static std::vector<MinecraftIcon> MinecraftIconSources; // per server, like MinecraftCaches
+static std::unordered_map<std::string, std::shared_ptr<const std::string>> MinecraftIcons;
+static std::mutex MinecraftIconMutex;
+
+static ProbeScheduler Scheduler;
+static HealthCheckEngine Checks; // the tcp and http servers, all on one thread
+
+static RoutesPublisher Publisher;
+static std::mutex PublishMutex;
+static std::unordered_map<std::string, std::string> LastPublished; // topic -> etag of the last published snapshot
+
+void ProbeMinecraftServers(const std::vector<size_t> &members, Minecraft::GameSpyClient &queryClient);
 JellyfinStatus GetJellyfinStatus();
 DashboardStatus GetDashboardStatus();
 DashboardHealthStatus GetHealthReport();
 
-std::string MCStatusToJSON(const Minecraft::MCStatus &status, bool cached);
-std::string JellyfinStatusToJSON(const JellyfinStatus &status, bool cached);
-std::string DashboardStatusToJSON(const DashboardStatus &status, bool cached);
-std::string HealthReportToJSON(const DashboardHealthStatus &status, bool cached);
+// Pushes the cache's latest snapshot to the topic's subscribers, unless nothing but the timing changed since last time.
+template<typename Store>
+static void publishIfChanged(const std::string &topic, const CacheContainer<Store> &cache) {
+    if (!Publisher)
+        return;
+
+    // snapshot, compare and publish in one go, so a thread that took its snapshot first can't publish it after a newer
+    // one (the mc ttl groups publish from their own threads)
+    std::lock_guard<std::mutex> lock(PublishMutex);
+    auto snapshot = cache.GetSnapshot();
+    if (!snapshot.headers || snapshot.headers->etag.empty())
+        return;
+
+    std::string &last = LastPublished[topic];
+    if (last == snapshot.headers->etag)
+        return;
+    last = snapshot.headers->etag;
+
+    Publisher(topic, *snapshot.body);
+}
 
-bool handleRoutes(const RequestData &req, ResponseData &res) {
-    res.status = 0;
+void setRoutesPublisher(RoutesPublisher publisher) { Publisher = std::move(publisher); }
 
-    static bool scannedConfig = false;
-    if (!scannedConfig) {
-        for (auto &server : DashConfig.servers) {
-            if (server.type == "minecraft") {
-                MinecraftInfo = const_cast<DashsrvConfigServer *>(&server);
-            }
+// Websocket subscribes, resyncs and history seeds aren't client requests for the cache, so they don't count as hits.
+std::string getTopicSnapshot(const std::string &topic) {
+    if (topic == "mc" && !MinecraftInfos.empty()) {
+        return *ServerCache.GetSnapshot().body;
+    }
 
-            if (server.type == "jellyfin") {
-                JellyfinInfo = const_cast<DashsrvConfigServer *>(&server);
-            }
+    if (topic == "jellyfin" && JellyfinInfo != nullptr) {
+        return *JellyfinCache.GetSnapshot().body;
+    }
+
+    if (topic == "checks" && !Checks.empty()) {
+        return *ChecksCache.GetSnapshot().body;
+    }
+
+    if (topic == "mesh") {
+        return *MeshCache.GetSnapshot().body;
+    }
+
+    if (topic == "local") {
+        return *HardwareCache.GetSnapshot().body;
+    }
+
+    return "";
+}
+
+void initRoutes() {
+    for (auto &server : dashConfig().servers) {
+        if (server.type == "minecraft") {
+            MinecraftInfos.push_back(&server);
+            MinecraftCaches.push_back(std::make_unique<CacheContainer<MinecraftServerStatus>>(10000));
+            MinecraftIconSources.emplace_back();
+        }
+
+        if (server.type == "jellyfin") {
+            JellyfinInfo = const_cast<DashsrvConfigServer *>(&server);
+        }
+
+        if (server.type == "tcp" || server.type == "http") {
+            const auto &check = std::get<DashsrvConfigServer::Check>(server.server);
+            Checks.addCheck({ check.name, server.type == "http", check.ip, check.port, check.path, check.expectStatus,
+                              check.expectBody, server.ttl != 0 ? server.ttl : 10000, check.timeout });
         }
+    }
 
-        scannedConfig = true;
+    // responses are serialized once per refresh, handlers only hand out the stored body
+    HardwareCache.SetSerializer(DashboardStatusToJSON);
+    MeshCache.SetSerializer(HealthReportToJSON);
+    ChecksCache.SetSerializer(HealthChecksToJSON);
+    JellyfinCache.SetSerializer(JellyfinStatusToJSON);
+    if (!MinecraftInfos.empty())
+        ServerCache.SetSerializer(MCNetworkToJSON);
+    for (auto &cache : MinecraftCaches)
+        cache->SetSerializer(MCStatusToJSON);
+
+    HardwareCache.SetCacheTimer(dashConfig().localTTL);
+    Scheduler.addProbe("local", dashConfig().localTTL, [] {
+        gCPUUsage.Tick();
+        HardwareCache.Cache(GetDashboardStatus());
+        publishIfChanged("local", HardwareCache);
+    });
+
+    MeshCache.SetCacheTimer(dashConfig().meshTTL);
+    Scheduler.addProbe("mesh", dashConfig().meshTTL, [] {
+        MeshCache.Cache(GetHealthReport());
+        publishIfChanged("mesh", MeshCache);
+    });
+
+    // servers sharing a ttl are probed together, all of them at once, so a group takes as long as its slowest server
+    std::map<uint64_t, std::vector<size_t>> minecraftGroups;
+    for (size_t i = 0; i < MinecraftInfos.size(); ++i) {
+        uint64_t ttl = MinecraftInfos[i]->ttl != 0 ? MinecraftInfos[i]->ttl : 10000;
+        MinecraftCaches[i]->SetCacheTimer(ttl);
+        minecraftGroups[ttl].push_back(i);
     }
 
+    if (!minecraftGroups.empty())
+        ServerCache.SetCacheTimer(minecraftGroups.begin()->first);
+
+    for (const auto &[ttl, members] : minecraftGroups) {
+        std::string name = minecraftGroups.size() == 1 ? "minecraft" : "minecraft/" + std::to_string(ttl) + "ms";
+        // query sockets and challenge tokens are kept by the group's client between probes
+        auto queryClient = std::make_shared<Minecraft::GameSpyClient>();
+        Scheduler.addProbe(name, ttl, [members, queryClient] { ProbeMinecraftServers(members, *queryClient); });
+    }
+
+    if (JellyfinInfo != nullptr) {
+        if (JellyfinInfo->ttl != 0)
+            JellyfinCache.SetCacheTimer(JellyfinInfo->ttl);
+
+        Scheduler.addProbe("jellyfin", JellyfinCache.GetCacheTimer(), [] {
+            JellyfinCache.Cache(GetJellyfinStatus());
+            publishIfChanged("jellyfin", JellyfinCache);
+        });
+    }
+
+    registerRoutes();
+    Scheduler.start();
+
+    if (!Checks.empty()) {
+        Checks.start([](const std::vector<HealthCheckStatus> &statuses) {
+            ChecksCache.Cache({ statuses });
+            publishIfChanged("checks", ChecksCache);
+        });
+    }
+}
+
+void registerRoutes() {
     ROUTE("/api") {
-        if (MinecraftInfo != nullptr) {
+        if (!MinecraftInfos.empty()) {
             GET("/mc") {
-                bool cached = true;
-                if (ServerCache.NeedsFetch()) {
-                    DashsrvConfigServer::Minecraft mci =
-                        std::get<DashsrvConfigServer::Minecraft>(MinecraftInfo->server);
-                    Minecraft::MCServer server{ mci.ip, (uint16_t)mci.port, (uint32_t)mci.version };
-                    Minecraft::MCStatus fetched = Minecraft::QueryServer(server);
-                    ServerCache.Cache(fetched);
-                    cached = false;
-                }
-
-                const Minecraft::MCStatus &status = ServerCache.Get();
+                auto snapshot = ServerCache.Lookup();
 
-                res.content_type = "application/json";
-                res.body = MCStatusToJSON(status, cached);
+                res.setCachedBody(snapshot.body, snapshot.headers);
                 res.status = 200;
                 res.handled = true;
-            }
+            };
+
+            // /api/mc/{name} and /api/mc/icon/{hash}, anything else is left to the 404 page
+            MOUNT("/mc") {
+                if (req.method != HttpMethod::GET && req.method != HttpMethod::HEAD)
+                    return;
+
+                static constexpr std::string_view IconPrefix = "/api/mc/icon/";
+                if (std::string_view(req.path).starts_with(IconPrefix)) {
+                    std::string hash(std::string_view(req.path).substr(IconPrefix.size()));
+                    std::shared_ptr<const std::string> png;
+                    {
+                        std::lock_guard<std::mutex> lock(MinecraftIconMutex);
+                        auto icon = MinecraftIcons.find(hash);
+                        if (icon != MinecraftIcons.end())
+                            png = icon->second;
+                    }
+                    if (!png)
+                        return;
+
+                    // the url changes with the content, so it never has to be asked for again
+                    res.setSharedBody(png, "image/png");
+                    res.status = 200;
+                    res.handled = true;
+                    res.headers["Cache-Control"] = "public, max-age=31536000, immutable";
+                    res.headers["ETag"] = "\"" + hash + "\"";
+                    return;
+                }
+
+                std::string_view name = req.path.substr(std::min(req.path.size(), sizeof("/api/mc/") - 1));
+                for (size_t i = 0; i < MinecraftInfos.size(); ++i) {
+                    if (std::get<DashsrvConfigServer::Minecraft>(MinecraftInfos[i]->server).name != name)
+                        continue;
+
+                    auto snapshot = MinecraftCaches[i]->Lookup();
+
+                    res.setCachedBody(snapshot.body, snapshot.headers);
+                    res.status = 200;
+                    res.handled = true;
+                    return;
+                }
+            };
         }
 
         if (JellyfinInfo != nullptr) {
             GET("/jellyfin") {
-                bool cached = true;
-                if (JellyfinCache.NeedsFetch()) {
-                    JellyfinStatus fetched = GetJellyfinStatus();
-                    JellyfinCache.Cache(fetched);
-                    cached = false;
-                }
+                auto snapshot = JellyfinCache.Lookup();
+
+                res.setCachedBody(snapshot.body, snapshot.headers);
+                res.status = 200;
+                res.handled = true;
+            };
+        }
 
-                const JellyfinStatus &status = JellyfinCache.Get();
+        if (!Checks.empty()) {
+            GET("/checks") {
+                auto snapshot = ChecksCache.Lookup();
 
-                res.content_type = "application/json";
-                res.body = JellyfinStatusToJSON(status, cached);
+                res.setCachedBody(snapshot.body, snapshot.headers);
                 res.status = 200;
                 res.handled = true;
-            }
+            };
         }
 
         GET("/status") {
-            bool cached = true;
-            if (MeshCache.NeedsFetch()) {
-                DashboardHealthStatus health = GetHealthReport();
-                MeshCache.Cache(health);
-                cached = false;
-            }
-
-            DashboardHealthStatus health = MeshCache.Get();
+            auto snapshot = MeshCache.Lookup();
 
-            res.content_type = "application/json";
-            res.body = HealthReportToJSON(health, cached);
+            res.setCachedBody(snapshot.body, snapshot.headers);
             res.status = 200;
             res.handled = true;
-        }
+        };
 
         GET("/local") {
-            bool cached = true;
-            if (HardwareCache.NeedsFetch()) {
-                DashboardStatus status = GetDashboardStatus();
-                HardwareCache.Cache(status);
-                cached = false;
-            }
+            auto snapshot = HardwareCache.Lookup();
 
-            DashboardStatus status = HardwareCache.Get();
-
-            res.content_type = "application/json";
-            res.body = DashboardStatusToJSON(status, cached);
+            res.setCachedBody(snapshot.body, snapshot.headers);
             res.status = 200;
             res.handled = true;
-        }
+        };
     }
 
     GET("/") {
@@ -161,13 +308,27 @@ bool handleRoutes(const RequestData &req, ResponseData &res) {
         res.headers["Content-Security-Policy"] =
             "default-src 'self'; img-src 'self' data:; style-src 'self' https://fonts.googleapis.com; font-src 'self' "
             "https://fonts.gstatic.com;";
-    }
+    };
 
-    GET("/favicon.ico") { res.respondFile("resources/static/favicon24x.png"); }
+    GET("/favicon.ico") { res.respondFile("resources/static/favicon24x.png"); };
 
-    if (req.path.starts_with("/static")) {
-        res.respondDirectory("resources/static/", "/static", req.url);
-    }
+    GET("/metrics") {
+        std::string metrics = Metrics::get().render();
+        StallWatchdog::get().render(metrics);
+
+        res.setBody(metrics, "text/plain; version=0.0.4; charset=utf-8");
+        res.headers["Cache-Control"] = "no-store";
+        res.status = 200;
+        res.handled = true;
+    };
+
+    MOUNT("/static") { res.respondDirectory("resources/static/", "/static", req.path); };
+}
+
+bool handleRoutes(const RequestData &req, ResponseData &res) {
+    res.status = 0;
+
+    gRouter.dispatch(req, res);
 
     if (res.status == 404 || res.status == 0) {
         res.respondFile("resources/static/common/404.html");
@@ -178,6 +339,101 @@ bool handleRoutes(const RequestData &req, ResponseData &res) {
     return res.handled;
 }
 
+// Moves the favicon out of a fresh status and returns the hash its PNG is served under. An offline server keeps the
+// icon it had, a server that dropped its icon (or sent a broken one) has none.
+static std::string internMinecraftIcon(size_t index, Minecraft::MCStatus &status) {
+    std::string favicon = std::move(status.Icon);
+    status.Icon.clear();
+
+    std::lock_guard<std::mutex> lock(MinecraftIconMutex);
+    MinecraftIcon &source = MinecraftIconSources[index];
+    if (!status.Online || favicon == source.Favicon)
+        return source.Hash;
+
+    source.Favicon = std::move(favicon);
+    source.Hash.clear();
+
+    std::string png;
+    if (!Minecraft::DecodeFavicon(source.Favicon, png))
+        return source.Hash;
+
+    mg_sha1_ctx ctx;
+    unsigned char digest[20];
+    mg_sha1_init(&ctx);
+    mg_sha1_update(&ctx, (const unsigned char *)png.data(), png.size());
+    mg_sha1_final(digest, &ctx);
+
+    static constexpr char hex[] = "0123456789abcdef";
+    for (unsigned char byte : digest) {
+        source.Hash += hex[byte >> 4];
+        source.Hash += hex[byte & 0x0F];
+    }
+
+    MinecraftIcons.try_emplace(source.Hash, std::make_shared<const std::string>(std::move(png)));
+    return source.Hash;
+}
+
+static void pruneMinecraftIcons() {
+    std::lock_guard<std::mutex> lock(MinecraftIconMutex);
+    if (MinecraftIcons.empty())
+        return;
+
+    std::unordered_set<std::string_view> used;
+    for (const MinecraftIcon &source : MinecraftIconSources)
+        used.insert(source.Hash);
+    std::erase_if(MinecraftIcons, [&](const auto &icon) { return !used.contains(icon.first); });
+}
+
+void ProbeMinecraftServers(const std::vector<size_t> &members, Minecraft::GameSpyClient &queryClient) {
+    std::vector<Minecraft::MCServer> pingServers, queryServers;
+    std::vector<size_t> pingMembers, queryMembers;
+    for (size_t i : members) {
+        const auto &mci = std::get<DashsrvConfigServer::Minecraft>(MinecraftInfos[i]->server);
+        if (mci.query) {
+            queryServers.push_back({ mci.ip, (uint16_t)mci.queryPort, 0 });
+            queryMembers.push_back(i);
+        } else {
+            pingServers.push_back({ mci.ip, (uint16_t)mci.port, (uint32_t)mci.version });
+            pingMembers.push_back(i);
+        }
+    }
+
+    // both kinds wait on the network at the same time, the queries on a second thread
+    std::future<std::vector<Minecraft::MCStatus>> queried;
+    if (!queryServers.empty())
+        queried = std::async(std::launch::async, [&] { return queryClient.QueryServers(queryServers); });
+
+    std::vector<Minecraft::MCStatus> pinged;
+    if (!pingServers.empty())
+        pinged = Minecraft::QueryServers(pingServers);
+
+    auto cacheStatuses = [](const std::vector<size_t> &indices, std::vector<Minecraft::MCStatus> statuses) {
+        for (size_t k = 0; k < indices.size(); ++k) {
+            const auto &mci = std::get<DashsrvConfigServer::Minecraft>(MinecraftInfos[indices[k]]->server);
+            std::string iconHash = internMinecraftIcon(indices[k], statuses[k]);
+            MinecraftCaches[indices[k]]->Cache({ mci.name, mci.ip, mci.extraDomain, mci.port, mci.version, mci.query,
+                                                 std::move(statuses[k]), std::move(iconHash) });
+        }
+    };
+
+    cacheStatuses(pingMembers, std::move(pinged));
+    if (queried.valid())
+        cacheStatuses(queryMembers, queried.get());
+    pruneMinecraftIcons();
+
+    // the list takes every server's latest snapshot, servers in other groups that weren't probed yet are left out
+    std::lock_guard<std::mutex> lock(MinecraftListMutex);
+    MinecraftNetworkStatus network;
+    for (const auto &cache : MinecraftCaches) {
+        auto status = cache->Get();
+        if (!status->Name.empty())
+            network.Servers.push_back(*status);
+    }
+
+    ServerCache.Cache(std::move(network));
+    publishIfChanged("mc", ServerCache);
+}
+
 JellyfinStatus GetJellyfinStatus() {
     DashsrvConfigServer::Jellyfin jfi = std::get<DashsrvConfigServer::Jellyfin>(JellyfinInfo->server);
     std::string jellyfinIP = jfi.ip + ":" + std::to_string(jfi.port);
@@ -186,7 +442,11 @@ JellyfinStatus GetJellyfinStatus() {
     status.Online = false;
 
     do {
-        MGResponse healthRes = Dashcli::Get(jellyfinIP + "/health");
+        // both requests go out together and are pipelined onto the same pooled connection
+        std::vector<MGResponse> responses =
+            Dashcli::GetAll({ jellyfinIP + "/health", jellyfinIP + "/System/Info/Public" });
+
+        const MGResponse &healthRes = responses[0];
         if (!healthRes.Success) {
             status.Online = false;
             break;
@@ -195,14 +455,14 @@ JellyfinStatus GetJellyfinStatus() {
         std::string healthstr(healthRes.Recv.begin(), healthRes.Recv.end());
         status.Health = healthstr;
 
-        MGResponse jsonRes = Dashcli::Get(jellyfinIP + "/System/Info/Public");
+        const MGResponse &jsonRes = responses[1];
         if (!jsonRes.Success) {
             status.Online = false;
             break;
         }
 
         std::string_view sv(reinterpret_cast<const char *>(jsonRes.Recv.data()), jsonRes.Recv.size());
-        nlohmann::json json = nlohmann::json::parse(sv);
+        nlohmann::json json = nlohmann::json::parse(sv, nullptr, false);
 
         if (json.is_discarded()) {
             status.Online = false;
@@ -254,14 +514,11 @@ DashboardStatus GetDashboardStatus() {
 
 DashboardHealthStatus GetHealthReport() {
     DashboardHealthStatus health;
-    if (HardwareCache.NeedsFetch()) {
-        HardwareCache.Cache(GetDashboardStatus());
-    }
-
-    DashboardStatus self = HardwareCache.Get();
+    DashboardStatus self = *HardwareCache.Get();
     health.Statuses.push_back(self);
 
-    for (const auto &serverInfo : DashConfig.servers) {
+    std::vector<std::string> peers;
+    for (const auto &serverInfo : dashConfig().servers) {
         if (serverInfo.type != "dashboard")
             continue;
 
@@ -281,24 +538,50 @@ DashboardHealthStatus GetHealthReport() {
         if (isSelf)
             continue;
 
+        peers.push_back(server);
+    }
+
+    // peers are revalidated with the ETag of their last answer, a 304 means the previous status still holds
+    std::vector<MGRequest> requests;
+    for (const auto &peer : peers) {
+        MGRequest request{ peer + "/api/local", {} };
+        auto known = PeerStatuses.find(peer);
+        if (known != PeerStatuses.end() && !known->second.ETag.empty())
+            request.Headers["If-None-Match"] = known->second.ETag;
+        requests.push_back(std::move(request));
+    }
+
+    // every peer is polled at once, so the report takes as long as the slowest peer rather than the sum of them
+    std::vector<MGResponse> responses = Dashcli::GetAll(requests);
+
+    for (size_t i = 0; i < peers.size(); ++i) {
+        const MGResponse &healthRes = responses[i];
+
         DashboardStatus status;
-        status.IPs.push_back(server);
+        status.IPs.push_back(peers[i]);
+        status.Online = false;
 
-        uint64_t start = GetTimeMillis();
-        MGResponse healthRes = Dashcli::Get(server + "/api/local");
         if (!healthRes.Success) {
-            status.Online = false;
+            PeerStatuses.erase(peers[i]);
+            health.Statuses.push_back(status);
+            continue;
+        }
+
+        auto known = PeerStatuses.find(peers[i]);
+        if (healthRes.Status == 304 && known != PeerStatuses.end()) {
+            status = known->second.Status;
+            status.Ping = healthRes.ElapsedMS;
             health.Statuses.push_back(status);
             continue;
         }
 
         std::string_view sv(reinterpret_cast<const char *>(healthRes.Recv.data()), healthRes.Recv.size());
-        nlohmann::json json = nlohmann::json::parse(sv);
+        nlohmann::json json = nlohmann::json::parse(sv, nullptr, false);
 
         if (json.is_discarded()) {
-            status.Online = false;
+            PeerStatuses.erase(peers[i]);
             health.Statuses.push_back(status);
-            break;
+            continue;
         }
 
         try {
@@ -308,13 +591,15 @@ DashboardHealthStatus GetHealthReport() {
             status.IPs = json["ips"];
             status.Memory.Available = json["memory"]["available"];
             status.Memory.Total = json["memory"]["total"];
-            status.Ping = GetTimeMillis() - start;
+            status.Ping = healthRes.ElapsedMS;
             health.Statuses.push_back(status);
+            PeerStatuses[peers[i]] = { healthRes.GetHeader("ETag"), status };
         } catch (const std::exception &e) {
             status.Online = false;
             status.IPs.clear();
-            status.IPs.push_back(server);
+            status.IPs.push_back(peers[i]);
             health.Statuses.push_back(status);
+            PeerStatuses.erase(peers[i]);
             continue;
         }
     }
@@ -322,26 +607,30 @@ DashboardHealthStatus GetHealthReport() {
     return health;
 }
 
-std::string MCStatusToJSON(const Minecraft::MCStatus &status, bool cached) {
-    DashsrvConfigServer::Minecraft mci = std::get<DashsrvConfigServer::Minecraft>(MinecraftInfo->server);
-
+std::string MCStatusToJSON(const MinecraftServerStatus &server, uint64_t cacheTiming) {
     try {
+        const Minecraft::MCStatus &status = server.Status;
+
         nlohmann::json json;
-        json["cached"] = cached;
-        json["cacheTiming"] = ServerCache.GetTiming();
+        json["cached"] = true;
+        json["cacheTiming"] = cacheTiming;
         json["online"] = status.Online;
-        json["ip"] = mci.ip;
-        json["domain"] = mci.extraDomain;
-        json["port"] = mci.port;
-        json["requestProtocol"] = mci.version;
+        json["name"] = server.Name;
+        json["ip"] = server.IP;
+        json["domain"] = server.Domain;
+        json["port"] = server.Port;
+        json["requestProtocol"] = server.RequestProtocol;
+        json["probe"] = server.Query ? "query" : "slp";
         if (status.Online) {
             json["version"]["name"] = status.Version.Name;
             json["version"]["protocol"] = status.Version.Protocol;
             json["motd"] = status.MOTD;
+            json["motdHtml"] = status.MOTDHtml;
             json["ping"] = status.PingMS;
             json["players"]["online"] = status.Players.Online;
             json["players"]["max"] = status.Players.Max;
-            json["icon"] = status.Icon;
+            json["players"]["names"] = status.Players.Names;
+            json["iconHash"] = server.IconHash;
         }
 
         return json.dump();
@@ -350,11 +639,11 @@ std::string MCStatusToJSON(const Minecraft::MCStatus &status, bool cached) {
     }
 }
 
-std::string JellyfinStatusToJSON(const JellyfinStatus &status, bool cached) {
+std::string JellyfinStatusToJSON(const JellyfinStatus &status, uint64_t cacheTiming) {
     try {
         nlohmann::json json;
-        json["cached"] = cached;
-        json["cacheTiming"] = JellyfinCache.GetTiming();
+        json["cached"] = true;
+        json["cacheTiming"] = cacheTiming;
         json["online"] = status.Online;
         json["healthString"] = status.Health;
         json["localAddress"] = status.LocalAddress;
@@ -371,18 +660,18 @@ std::string JellyfinStatusToJSON(const JellyfinStatus &status, bool cached) {
     }
 }
 
-std::string DashboardStatusToJSON(const DashboardStatus &status, bool cached) {
+std::string DashboardStatusToJSON(const DashboardStatus &status, uint64_t cacheTiming) {
     try {
         nlohmann::json json;
-        json["cached"] = cached;
-        json["cacheTiming"] = HardwareCache.GetTiming();
+        json["cached"] = true;
+        json["cacheTiming"] = cacheTiming;
         json["online"] = status.Online;
         json["ips"] = status.IPs;
         if (status.Online) {
             if (std::isfinite(status.CPU)) {
                 json["cpu"] = status.CPU;
             } else {
-                json["cpu"] = LastValidCPUUsage;
+                json["cpu"] = LastValidCPUUsage.load();
             }
 
             json["ping"] = status.Ping;
@@ -399,19 +688,69 @@ std::string DashboardStatusToJSON(const DashboardStatus &status, bool cached) {
     }
 }
 
-std::string HealthReportToJSON(const DashboardHealthStatus &status, bool cached) {
+std::string MCNetworkToJSON(const MinecraftNetworkStatus &status, uint64_t cacheTiming) {
+    std::string data = "";
+    for (size_t i = 0; i < status.Servers.size(); ++i) {
+        if (i != 0)
+            data += ",";
+        data += MCStatusToJSON(status.Servers[i], cacheTiming);
+    }
+
+    std::stringstream ss;
+    ss << "{";
+    ss << "\"cached\":" << true << ",";
+    ss << "\"cacheTiming\":" << cacheTiming << ",";
+    ss << "\"data\":[" << data << "]";
+    ss << "}";
+    return ss.str();
+}
+
+std::string HealthReportToJSON(const DashboardHealthStatus &status, uint64_t cacheTiming) {
     std::string data = "";
     for (size_t i = 0; i < status.Statuses.size(); ++i) {
         if (i != 0)
             data += ",";
-        data += DashboardStatusToJSON(status.Statuses[i], cached);
+        data += DashboardStatusToJSON(status.Statuses[i], cacheTiming);
     }
 
     std::stringstream ss;
     ss << "{";
-    ss << "\"cached\":" << (cached ? true : false) << ",";
-    ss << "\"cacheTiming\":" << MeshCache.GetTiming() << ",";
+    ss << "\"cached\":" << true << ",";
+    ss << "\"cacheTiming\":" << cacheTiming << ",";
     ss << "\"data\":[" << data << "]";
     ss << "}";
     return ss.str();
 }
+
+std::string HealthChecksToJSON(const HealthCheckReport &report, uint64_t cacheTiming) {
+    try {
+        // times that weren't measured are null rather than -1
+        auto millis = [](double ms) { return ms < 0 ? nlohmann::json(nullptr) : nlohmann::json(ms); };
+
+        nlohmann::json json;
+        json["cached"] = true;
+        json["cacheTiming"] = cacheTiming;
+        json["data"] = nlohmann::json::array();
+        for (const auto &check : report.Checks) {
+            nlohmann::json entry;
+            entry["name"] = check.Name;
+            entry["type"] = check.Type;
+            entry["target"] = check.Target;
+            entry["checked"] = check.Checked;
+            entry["up"] = check.Up;
+            if (!check.Error.empty())
+                entry["error"] = check.Error;
+            if (check.Type == "http")
+                entry["status"] = check.Status;
+            entry["connectMS"] = millis(check.ConnectMS);
+            entry["ttfbMS"] = millis(check.FirstByteMS);
+            entry["totalMS"] = millis(check.TotalMS);
+            entry["checkedAt"] = check.CheckedAt;
+            json["data"].push_back(std::move(entry));
+        }
+
+        return json.dump();
+    } catch (const std::exception &e) {
+        return "{}";
+    }
+}
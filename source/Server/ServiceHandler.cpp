@@ -2,9 +2,13 @@
 
 #include <Basic.h>
 #include <Server/Config.h>
+#include <Server/Core/Watchdog.h>
 #include <Server/Routes.h>
 
+#include <nlohmann/json.hpp>
+
 #include <iostream>
+#include <vector>
 
 ServiceHandler::~ServiceHandler() {
     if (mServer)
@@ -15,6 +19,8 @@ void ServiceHandler::init() {
     DashsrvConfig config("resources/config.json");
     std::cout << "Loaded configuration 'resources/config.json':\n";
     std::cout << "  IP: " << config.ip << ":" << config.port << "\n";
+    std::cout << "  Workers: " << config.workers << "\n";
+    std::cout << "  Stall budget: " << config.stallBudget << "ms\n";
     std::cout << "  Servers: " << config.servers.size() << "\n";
     for (const auto &server : config.servers) {
         std::string ip, port;
@@ -27,11 +33,25 @@ void ServiceHandler::init() {
         } else if (server.type == "dashboard") {
             ip = std::get<DashsrvConfigServer::Dashboard>(server.server).ip;
             port = std::to_string(std::get<DashsrvConfigServer::Dashboard>(server.server).port);
+        } else if (server.type == "tcp" || server.type == "http") {
+            ip = std::get<DashsrvConfigServer::Check>(server.server).ip;
+            port = std::to_string(std::get<DashsrvConfigServer::Check>(server.server).port);
         }
         std::cout << "    " << server.type << " " << ip << ":" << port << "\n";
     }
 
-    mServer = new NoreServer("http://" + config.ip + ":" + std::to_string(config.port), handleRoutes);
+    StallWatchdog::get().setBudget(config.stallBudget);
+
+    mServer = new NoreServer("http://" + config.ip + ":" + std::to_string(config.port), handleRoutes, config.workers);
+    mServer->attachWebsocketTools(
+        [this](const std::string &id) { onWebsocketConnect(id); },
+        [this](const std::string &id, const std::string &data) { onWebsocketMessage(id, data); },
+        [this](const std::string &id) { onWebsocketClose(id); });
+
+    AssetCache::get().preload("resources/static");
+
+    setRoutesPublisher([this](const std::string &topic, const std::string &message) { publish(topic, message); });
+    initRoutes();
 }
 
 void ServiceHandler::run() {
@@ -41,3 +61,128 @@ void ServiceHandler::run() {
 
     mServer->run();
 }
+
+void ServiceHandler::onWebsocketConnect(const std::string &id) {
+    std::lock_guard<std::mutex> lock(mClientsMutex);
+    mClients[id] = UserClient{ .id = id, .name = "", .isAdmin = false };
+}
+
+void ServiceHandler::onWebsocketClose(const std::string &id) {
+    std::lock_guard<std::mutex> lock(mClientsMutex);
+    mClients.erase(id);
+}
+
+// Clients manage their subscriptions with {"subscribe":["mc","local"]} and {"unsubscribe":["mc"]}. Updates are sent as
+// binary delta frames (see DeltaFrame.h) against the last version the client confirmed with {"ack":{"mc":12}}, a new
+// subscription or {"resync":["mc"]} gets a full snapshot.
+void ServiceHandler::onWebsocketMessage(const std::string &id, const std::string &data) {
+    nlohmann::json json = nlohmann::json::parse(data, nullptr, false);
+    if (json.is_discarded() || !json.is_object())
+        return;
+
+    std::vector<std::string> frames;
+    {
+        std::lock_guard<std::mutex> lock(mClientsMutex);
+        auto it = mClients.find(id);
+        if (it == mClients.end())
+            return;
+
+        UserClient &client = it->second;
+        std::vector<std::string> resync;
+
+        if (json.contains("subscribe") && json["subscribe"].is_array()) {
+            for (const auto &topic : json["subscribe"]) {
+                if (topic.is_string() && client.topics.insert(topic.get<std::string>()).second)
+                    resync.push_back(topic.get<std::string>());
+            }
+        }
+
+        if (json.contains("unsubscribe") && json["unsubscribe"].is_array()) {
+            for (const auto &topic : json["unsubscribe"]) {
+                if (!topic.is_string())
+                    continue;
+                client.topics.erase(topic.get<std::string>());
+                client.acked.erase(topic.get<std::string>());
+            }
+        }
+
+        if (json.contains("ack") && json["ack"].is_object()) {
+            for (const auto &[topic, version] : json["ack"].items()) {
+                if (client.topics.contains(topic) && version.is_number_unsigned())
+                    client.acked[topic] = version.get<uint32_t>();
+            }
+        }
+
+        if (json.contains("resync") && json["resync"].is_array()) {
+            for (const auto &topic : json["resync"]) {
+                if (topic.is_string() && client.topics.contains(topic.get<std::string>()))
+                    resync.push_back(topic.get<std::string>());
+            }
+        }
+
+        for (const auto &topic : resync) {
+            client.acked[topic] = 0;
+            if (DeltaFrame::TopicHistory *history = topicHistory(topic))
+                frames.push_back(history->encode(0));
+        }
+    }
+
+    for (const auto &frame : frames) {
+        mServer->sendToWebsocket(id, frame);
+    }
+}
+
+void ServiceHandler::publish(const std::string &topic, const std::string &document) {
+    nlohmann::json json = nlohmann::json::parse(document, nullptr, false);
+    if (json.is_discarded())
+        return;
+
+    std::vector<std::pair<std::string, uint32_t>> subscribers;
+    DeltaFrame::TopicHistory *history;
+    {
+        std::lock_guard<std::mutex> lock(mClientsMutex);
+        // pushed under the lock so a client subscribing right now gets either this version or a delta to it. A history
+        // created here starts out with this document, so it isn't pushed twice.
+        bool created = !mTopics.contains(topic);
+        history = topicHistory(topic, &json);
+        if (history == nullptr)
+            return;
+        if (!created)
+            history->push(json);
+
+        for (const auto &[id, client] : mClients) {
+            if (!client.topics.contains(topic))
+                continue;
+
+            auto acked = client.acked.find(topic);
+            subscribers.emplace_back(id, acked != client.acked.end() ? acked->second : 0);
+        }
+    }
+
+    // most clients sit on the same acknowledged version, so each distinct frame is only built once
+    std::unordered_map<uint32_t, std::string> frames;
+    for (const auto &[id, base] : subscribers) {
+        auto it = frames.find(base);
+        if (it == frames.end())
+            it = frames.emplace(base, history->encode(base)).first;
+
+        mServer->sendToWebsocket(id, it->second);
+    }
+}
+
+DeltaFrame::TopicHistory *ServiceHandler::topicHistory(const std::string &topic, const nlohmann::json *seed) {
+    auto it = mTopics.find(topic);
+    if (it != mTopics.end())
+        return it->second.get();
+
+    auto history = std::make_unique<DeltaFrame::TopicHistory>(topic);
+    if (seed != nullptr) {
+        history->push(*seed);
+    } else {
+        std::string document = getTopicSnapshot(topic);
+        if (document.empty())
+            return nullptr;
+        history->push(nlohmann::json::parse(document, nullptr, false));
+    }
+    return mTopics.emplace(topic, std::move(history)).first->second.get();
+}
@@ -0,0 +1,406 @@
+// dashsrv_bench: micro-benchmarks for the code on the request and probe paths. Reports ns/op and allocations/op, as a
+// table or (with --json) as a JSON array that can be diffed between releases.
+//
+//   dashsrv_bench [--json] [--filter <substring>] [--time <ms per benchmark>]
+//
+// Run it from the repository root so the route benchmarks find resources/static.
+
+#include <Basic.h>
+
+#include <Minecraft/GameSpy.h>
+#include <Minecraft/MCPacket.h>
+#include <Minecraft/Status.h>
+#include <Minecraft/String.h>
+#include <Server/Core/HTTP.h>
+#include <Server/Core/Server.h>
+#include <Server/Routes.h>
+#include <Server/Statuses.h>
+
+#include <mongoose.h>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every allocation in the process goes through these, so allocations/op covers the std containers and json as well.
+// GCC can't tell the replaced pair belongs together once they're inlined into callers in this file.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+static std::atomic<uint64_t> gAllocations{ 0 };
+static std::atomic<uint64_t> gAllocatedBytes{ 0 };
+
+void *operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+// Keeps the compiler from dropping a result it can see is unused.
+template<typename T>
+static void keep(T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Benchmark {
+    std::string name;
+    std::function<void(uint64_t iterations)> run;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+};
+
+static Result measure(const Benchmark &bench, std::chrono::nanoseconds minTime) {
+    using Clock = std::chrono::steady_clock;
+
+    bench.run(1); // warm up caches and any lazily built state
+
+    uint64_t iterations = 1;
+    for (;;) {
+        uint64_t allocs = gAllocations.load(std::memory_order_relaxed);
+        uint64_t bytes = gAllocatedBytes.load(std::memory_order_relaxed);
+        auto start = Clock::now();
+        bench.run(iterations);
+        auto elapsed = Clock::now() - start;
+        allocs = gAllocations.load(std::memory_order_relaxed) - allocs;
+        bytes = gAllocatedBytes.load(std::memory_order_relaxed) - bytes;
+
+        if (elapsed >= minTime || iterations >= (1ull << 32)) {
+            double n = (double)iterations;
+            return { bench.name, iterations, std::chrono::duration<double, std::nano>(elapsed).count() / n,
+                     allocs / n, bytes / n };
+        }
+
+        // aim a bit past minTime, but never grow by more than 100x at once
+        double scale = elapsed.count() > 0 ? 1.2 * (double)minTime.count() / (double)elapsed.count() : 100;
+        iterations = (uint64_t)((double)iterations * std::min(100.0, std::max(2.0, scale)));
+    }
+}
+
+// What a vanilla server answers to the handshake, status request and ping, as QueryServer collects it.
+static std::vector<uint8_t> capturedStatusResponse() {
+    using namespace Minecraft::packetool;
+
+    std::string json = R"({"version":{"name":"1.21.11","protocol":774},"enforcesSecureChat":true,)"
+                       R"("description":"A Minecraft Server","players":{"max":20,"online":3,"sample":[)"
+                       R"({"name":"Alex","id":"ec561538-f3fd-461d-aff5-086b22154bce"},)"
+                       R"({"name":"Steve","id":"8667ba71-b85a-4004-af54-457a9734eed7"}]},)"
+                       R"("favicon":"data:image/png;base64,)" +
+                       std::string(4096, 'A') + R"("})";
+
+    std::vector<uint8_t> status;
+    status.push_back(MC_PACKETACC_STATUS);
+    WriteVarInt(status, (int32_t)json.size());
+    status.insert(status.end(), json.begin(), json.end());
+    WriteVarInt(status, status.begin(), (int32_t)status.size());
+
+    std::vector<uint8_t> pong;
+    pong.push_back(MC_PACKETACC_PONG);
+    WriteLong(pong, (int64_t)GetTimeMS());
+    WriteVarInt(pong, pong.begin(), (int32_t)pong.size());
+
+    status.insert(status.end(), pong.begin(), pong.end());
+    return status;
+}
+
+// A query full stat from a full 40 player server, as vanilla sends it.
+static std::vector<uint8_t> capturedFullStatResponse() {
+    using namespace Minecraft::packetool;
+
+    std::vector<uint8_t> stat;
+    stat.push_back(GS_PACKET_STAT);
+    WriteInt(stat, 0x01020304);
+
+    auto text = [&](const std::string &value) {
+        stat.insert(stat.end(), value.c_str(), value.c_str() + value.size() + 1); // with the terminator
+    };
+    text("splitnum");
+    stat.push_back(0x80);
+    stat.push_back(0x00);
+
+    for (const char *pair : { "hostname", "A Minecraft Server", "gametype", "SMP", "game_id", "MINECRAFT", "version",
+                              "1.21.11", "plugins", "", "map", "world", "numplayers", "40", "maxplayers", "40",
+                              "hostport", "25565", "hostip", "0.0.0.0" })
+        text(pair);
+    stat.push_back(0x00);
+
+    text("\x01player_");
+    stat.push_back(0x00);
+    for (int i = 0; i < 40; ++i)
+        text("Player" + std::to_string(i));
+    stat.push_back(0x00);
+    return stat;
+}
+
+static DashboardStatus sampleDashboardStatus() {
+    DashboardStatus status;
+    status.IPs = { "127.0.0.1", "192.168.0.100", "10.0.0.4" };
+    status.Memory.Available = 5424;
+    status.Memory.Total = 16003;
+    status.CPU = 12.71;
+    status.Ping = 3;
+    status.IsCurrent = true;
+    status.Online = true;
+    return status;
+}
+
+static std::vector<Benchmark> benchmarks() {
+    std::vector<Benchmark> list;
+
+    list.push_back({ "packetool/WriteVarInt", [](uint64_t n) {
+                        static const int32_t values[] = { 0, 127, 300, 25565, 2097151, -1 };
+                        std::vector<uint8_t> out;
+                        out.reserve(64);
+                        for (uint64_t i = 0; i < n; ++i) {
+                            out.clear();
+                            for (int32_t v : values)
+                                Minecraft::packetool::WriteVarInt(out, v);
+                            keep(out);
+                        }
+                    } });
+
+    list.push_back({ "packetool/ReadVarInt", [](uint64_t n) {
+                        std::vector<uint8_t> encoded;
+                        for (int32_t v : { 0, 127, 300, 25565, 2097151, -1 })
+                            Minecraft::packetool::WriteVarInt(encoded, v);
+
+                        for (uint64_t i = 0; i < n; ++i) {
+                            uint8_t *cursor = encoded.data();
+                            int32_t sum = 0;
+                            for (int k = 0; k < 6; ++k)
+                                sum += Minecraft::packetool::ReadVarInt(cursor);
+                            keep(sum);
+                        }
+                    } });
+
+    list.push_back({ "minecraft/BuildHandshakePacket", [](uint64_t n) {
+                        Minecraft::MCServer server{ "mc.example.net", 25565, 774 };
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto packet = Minecraft::inte__::BuildHandshakePacket(server);
+                            keep(packet);
+                        }
+                    } });
+
+    list.push_back({ "minecraft/ParseStatusResponse", [](uint64_t n) {
+                        std::vector<uint8_t> captured = capturedStatusResponse();
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto status = Minecraft::ParseStatusResponse(captured);
+                            keep(status);
+                        }
+                    } });
+
+    // the same response as it arrives over a slow link, a few bytes per read
+    list.push_back({ "minecraft/PacketFramer 7 byte reads", [](uint64_t n) {
+                        std::vector<uint8_t> captured = capturedStatusResponse();
+                        std::vector<uint8_t> packet;
+                        for (uint64_t i = 0; i < n; ++i) {
+                            Minecraft::packetool::PacketFramer framer;
+                            size_t packets = 0;
+                            for (size_t at = 0; at < captured.size(); at += 7) {
+                                framer.Feed(captured.data() + at, std::min<size_t>(7, captured.size() - at));
+                                while (framer.Next(packet))
+                                    ++packets;
+                            }
+                            keep(packets);
+                        }
+                    } });
+
+    list.push_back({ "minecraft/ParseFullStatResponse", [](uint64_t n) {
+                        std::vector<uint8_t> captured = capturedFullStatResponse();
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto status = Minecraft::ParseFullStatResponse(captured.data(), captured.size());
+                            keep(status);
+                        }
+                    } });
+
+    list.push_back({ "minecraft/DecodeFavicon", [](uint64_t n) {
+                        std::vector<uint8_t> captured = capturedStatusResponse();
+                        std::string favicon = Minecraft::ParseStatusResponse(captured).Icon;
+                        std::string png;
+                        for (uint64_t i = 0; i < n; ++i) {
+                            Minecraft::DecodeFavicon(favicon, png);
+                            keep(png);
+                        }
+                    } });
+
+    list.push_back({ "minecraft/EscapeToAnsi", [](uint64_t n) {
+                        std::string motd = "§aA §lMinecraft§r Server §6- §bsurvival "
+                                           "§7| §e1.21.11 §kxx§r";
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto ansi = Minecraft::EscapeToAnsi(motd);
+                            keep(ansi);
+                        }
+                    } });
+
+    // the description most servers send, a chat component, as the probe renders it for the dashboard
+    list.push_back({ "minecraft/FormatChatComponent html", [](uint64_t n) {
+                        nlohmann::json description = nlohmann::json::parse(
+                            R"({"text":"","extra":[{"text":"A ","color":"green"},)"
+                            R"({"text":"Minecraft","color":"green","bold":true},{"text":" Server <survival>\n"},)"
+                            R"({"text":"1.21.11","color":"#FFAA00",)"
+                            R"("extra":[{"text":" | ","color":"gray"},"§ehello"]}]})");
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto html = Minecraft::FormatChatComponent(description, Minecraft::TextFormat::Html);
+                            keep(html);
+                        }
+                    } });
+
+    list.push_back({ "http/parseQueryParams", [](uint64_t n) {
+                        std::string_view query = "topic=mc&name=hello%20world&empty=&flag&q=a+b&page=12";
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto params = parseQueryParams(query);
+                            keep(params);
+                        }
+                    } });
+
+    list.push_back({ "http/constructResponseHeaders", [](uint64_t n) {
+                        // a cached API response, headers formatted with the snapshot
+                        ResponseData res;
+                        res.setCachedBody(std::make_shared<const std::string>(1024, 'x'),
+                                          makeCachedHeaders("application/json",
+                                                            "\"3f786850e387550fdab836ed7e6dc881de23001b\"",
+                                                            GetTimeMillis() - 3000));
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto head = constructResponseHeaders(res);
+                            keep(head);
+                        }
+                    } });
+
+    list.push_back({ "json/MCStatusToJSON", [](uint64_t n) {
+                        std::vector<uint8_t> captured = capturedStatusResponse();
+                        Minecraft::MCStatus parsed = Minecraft::ParseStatusResponse(captured);
+                        parsed.Icon.clear(); // the probe swaps it for the hash
+                        MinecraftServerStatus status{ "survival", "mc.example.net", "", 25565, 774, false,
+                                                      std::move(parsed), "3f786850e387550fdab836ed7e6dc881de23001b" };
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto json = MCStatusToJSON(status, 1792220768549);
+                            keep(json);
+                        }
+                    } });
+
+    list.push_back({ "json/JellyfinStatusToJSON", [](uint64_t n) {
+                        JellyfinStatus status{ true,
+                                               "Healthy",
+                                               "http://192.168.0.100:8096",
+                                               "media",
+                                               "10.10.7",
+                                               "Jellyfin Server",
+                                               "Linux",
+                                               "0f4d3c8a5b2e4f6c9a1d7e3b5c8f2a6d",
+                                               true };
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto json = JellyfinStatusToJSON(status, 1792220768549);
+                            keep(json);
+                        }
+                    } });
+
+    list.push_back({ "json/DashboardStatusToJSON", [](uint64_t n) {
+                        DashboardStatus status = sampleDashboardStatus();
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto json = DashboardStatusToJSON(status, 1792220768549);
+                            keep(json);
+                        }
+                    } });
+
+    list.push_back({ "json/HealthReportToJSON", [](uint64_t n) {
+                        DashboardHealthStatus report;
+                        for (int k = 0; k < 4; ++k) {
+                            report.Statuses.push_back(sampleDashboardStatus());
+                            report.Statuses.back().IsCurrent = k == 0;
+                        }
+                        for (uint64_t i = 0; i < n; ++i) {
+                            auto json = HealthReportToJSON(report, 1792220768549);
+                            keep(json);
+                        }
+                    } });
+
+    // dispatch through handleRoutes, from a request mongoose parsed, to a filled in ResponseData
+    for (const char *target : { "/api/status", "/favicon.ico", "/static/js/dash.js", "/does/not/exist" }) {
+        list.push_back({ std::string("routes/handleRoutes ") + target, [target](uint64_t n) {
+                            std::string raw = std::string("GET ") + target +
+                                              " HTTP/1.1\r\nHost: dash.local\r\nUser-Agent: bench\r\n"
+                                              "Accept-Encoding: gzip\r\n\r\n";
+                            struct mg_http_message hm;
+                            mg_http_parse(raw.data(), raw.size(), &hm);
+
+                            struct mg_connection conn;
+                            std::memset(&conn, 0, sizeof(conn));
+
+                            for (uint64_t i = 0; i < n; ++i) {
+                                RequestData req(&hm, &conn);
+                                ResponseData res;
+                                handleRoutes(req, res);
+                                keep(res);
+                            }
+                        } });
+    }
+
+    return list;
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    std::string filter;
+    uint64_t timeMS = 200;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--time" && i + 1 < argc) {
+            timeMS = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--json] [--filter <substring>] [--time <ms>]\n";
+            return 1;
+        }
+    }
+
+    registerRoutes();
+
+    std::vector<Result> results;
+    for (const auto &bench : benchmarks()) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos)
+            continue;
+
+        results.push_back(measure(bench, std::chrono::milliseconds(timeMS)));
+
+        if (!json) {
+            const Result &r = results.back();
+            std::printf("%-40s %12llu iters %12.1f ns/op %8.2f allocs/op %10.1f B/op\n", r.name.c_str(),
+                        (unsigned long long)r.iterations, r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+        }
+    }
+
+    if (json) {
+        nlohmann::json out = nlohmann::json::array();
+        for (const auto &r : results) {
+            out.push_back({ { "name", r.name },
+                            { "iterations", r.iterations },
+                            { "ns_per_op", r.nsPerOp },
+                            { "allocs_per_op", r.allocsPerOp },
+                            { "bytes_per_op", r.bytesPerOp } });
+        }
+        std::cout << out.dump(2) << "\n";
+    }
+
+    return 0;
+}
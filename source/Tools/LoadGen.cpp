@@ -0,0 +1,552 @@
+// dashsrv_loadgen: drives a running dashsrv over many keep-alive connections and reports throughput and latency.
+//
+//   dashsrv_loadgen [options] [http://host:port]
+//
+//   --connections <n>   concurrent keep-alive HTTP connections (default 64)
+//   --threads <n>       event loop threads, connections are split between them (default 2)
+//   --duration <s>      measured time (default 10)
+//   --warmup <s>        time before measuring starts (default 2)
+//   --request <path[=weight]>
+//                       adds a path to the request mix, repeatable (default: a dashboard page load)
+//   --websockets <n>    websocket subscribers on /ws, subscribed to every topic (default 0)
+//   --gzip              send Accept-Encoding: gzip
+//   --seed <n>          seeds the request mix, the same seed gives the same sequence per connection (default 1)
+//   --hdr               also print the full percentile distribution
+//   --json              print the report as JSON
+//
+// Every connection sends its next request as soon as the previous response arrived (closed loop), so with a fixed
+// config, mix and seed two runs differ only in how fast the server is.
+
+#include <mongoose.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Log-linear latency histogram in microseconds, in the spirit of HdrHistogram: 64 linear sub-buckets per power of two
+// keep the error of any reported value under 1.6%, whatever its magnitude.
+class LatencyHistogram {
+  public:
+    LatencyHistogram() : mCounts(BucketCount, 0) {}
+
+    void record(uint64_t micros) {
+        ++mCounts[indexOf(micros)];
+        ++mTotal;
+        mSum += micros;
+        mMax = std::max(mMax, micros);
+    }
+
+    void merge(const LatencyHistogram &other) {
+        for (size_t i = 0; i < BucketCount; ++i)
+            mCounts[i] += other.mCounts[i];
+        mTotal += other.mTotal;
+        mSum += other.mSum;
+        mMax = std::max(mMax, other.mMax);
+    }
+
+    uint64_t count() const { return mTotal; }
+    uint64_t max() const { return mMax; }
+    double mean() const { return mTotal == 0 ? 0 : (double)mSum / (double)mTotal; }
+
+    // The highest value in the bucket holding the given percentile (0-100), as HdrHistogram reports it.
+    uint64_t percentile(double p) const {
+        if (mTotal == 0)
+            return 0;
+
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)((p / 100.0) * (double)mTotal + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BucketCount; ++i) {
+            seen += mCounts[i];
+            if (seen >= rank)
+                return std::min(highestOf(i), mMax);
+        }
+        return mMax;
+    }
+
+    // Rows of the classic HdrHistogram percentile distribution: five rows per halving of the distance to 100%.
+    void printDistribution(std::FILE *out) const {
+        std::fprintf(out, "%12s %14s %12s %16s\n", "Value(ms)", "Percentile", "TotalCount", "1/(1-Percentile)");
+
+        for (int half = 0; mTotal > 0 && half < 30; ++half) {
+            double base = 100.0 - 100.0 / std::pow(2.0, half);
+            double span = 100.0 / std::pow(2.0, half + 1);
+
+            uint64_t below = 0;
+            for (int tick = 0; tick < 5; ++tick) {
+                double p = base + span * tick / 5;
+                uint64_t value = percentile(p);
+                below = countAtOrBelow(value);
+                std::fprintf(out, "%12.3f %14.12f %12llu %16.2f\n", value / 1000.0, p / 100.0,
+                             (unsigned long long)below, 1.0 / (1.0 - p / 100.0));
+            }
+
+            if (below >= mTotal)
+                break;
+        }
+
+        std::fprintf(out, "%12.3f %14.12f %12llu %16s\n", mMax / 1000.0, 1.0, (unsigned long long)mTotal, "inf");
+        std::fprintf(out, "#[Mean = %.3f, Max = %.3f, Total count = %llu] (ms)\n", mean() / 1000.0, mMax / 1000.0,
+                     (unsigned long long)mTotal);
+    }
+
+  private:
+    static constexpr unsigned SubBucketBits = 7; // values below 128us are exact
+    static constexpr size_t HalfBucket = 1u << (SubBucketBits - 1);
+    static constexpr size_t BucketCount = (1u << SubBucketBits) + 48 * HalfBucket; // up to 2^54us
+
+    std::vector<uint64_t> mCounts;
+    uint64_t mTotal = 0;
+    uint64_t mSum = 0;
+    uint64_t mMax = 0;
+
+    static size_t indexOf(uint64_t v) {
+        if (v < (1u << SubBucketBits))
+            return (size_t)v;
+
+        unsigned shift = (unsigned)std::bit_width(v) - SubBucketBits;
+        size_t index = (1u << SubBucketBits) + (shift - 1) * HalfBucket + ((v >> shift) - HalfBucket);
+        return std::min(index, BucketCount - 1);
+    }
+
+    static uint64_t highestOf(size_t index) {
+        if (index < (1u << SubBucketBits))
+            return index;
+
+        size_t k = index - (1u << SubBucketBits);
+        unsigned shift = (unsigned)(k / HalfBucket) + 1;
+        uint64_t top = k % HalfBucket + HalfBucket;
+        return ((top + 1) << shift) - 1;
+    }
+
+    uint64_t countAtOrBelow(uint64_t value) const {
+        uint64_t seen = 0;
+        for (size_t i = 0; i <= indexOf(value); ++i)
+            seen += mCounts[i];
+        return seen;
+    }
+};
+
+struct RequestMix {
+    struct Entry {
+        std::string path;
+        unsigned weight;
+    };
+
+    std::vector<Entry> entries;
+    unsigned totalWeight = 0;
+
+    // Only a trailing =<digits> is a weight, so a query string like /api/x?a=b stays part of the path.
+    void add(const std::string &spec) {
+        size_t eq = spec.rfind('=');
+        Entry entry{ spec, 1 };
+        bool weighted = eq != std::string::npos && eq > 0 && eq + 1 < spec.size() &&
+                        spec.find_first_not_of("0123456789", eq + 1) == std::string::npos;
+        if (weighted) {
+            entry.path = spec.substr(0, eq);
+            entry.weight = (unsigned)std::max(1l, std::strtol(spec.c_str() + eq + 1, nullptr, 10));
+        }
+        totalWeight += entry.weight;
+        entries.push_back(entry);
+    }
+
+    size_t pick(std::mt19937 &rng) const {
+        unsigned roll = std::uniform_int_distribution<unsigned>(0, totalWeight - 1)(rng);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (roll < entries[i].weight)
+                return i;
+            roll -= entries[i].weight;
+        }
+        return entries.size() - 1;
+    }
+};
+
+struct Options {
+    std::string url = "http://127.0.0.1:8080";
+    int connections = 64;
+    int threads = 2;
+    double duration = 10;
+    double warmup = 2;
+    int websockets = 0;
+    bool gzip = false;
+    uint32_t seed = 1;
+    bool hdr = false;
+    bool json = false;
+    RequestMix mix;
+};
+
+struct PathStats {
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    LatencyHistogram latency;
+};
+
+// One per thread, merged once the run is over.
+struct ThreadStats {
+    LatencyHistogram latency;
+    std::vector<PathStats> paths;
+    std::vector<uint64_t> statusClasses = std::vector<uint64_t>(6, 0); // index = status / 100
+    uint64_t errors = 0;
+    uint64_t reconnects = 0;
+    uint64_t wsFrames = 0;
+    uint64_t wsBytes = 0;
+    int wsOpen = 0;
+};
+
+struct Worker;
+
+struct LoadConn {
+    Worker *worker;
+    std::mt19937 rng;
+    size_t path = 0;
+    Clock::time_point sentAt;
+    bool websocket = false;
+};
+
+struct Worker {
+    const Options *options;
+    struct mg_mgr mgr;
+    std::string host;
+    std::vector<std::unique_ptr<LoadConn>> conns;
+    ThreadStats stats;
+    Clock::time_point measureFrom, measureUntil;
+    bool running = true;
+};
+
+static void loadHandler(struct mg_connection *c, int ev, void *ev_data);
+
+static void openConnection(LoadConn *conn) {
+    const Options &opts = *conn->worker->options;
+    if (conn->websocket) {
+        std::string url = opts.url;
+        url.replace(0, url.find("://"), url.starts_with("https") ? "wss" : "ws");
+        mg_ws_connect(&conn->worker->mgr, (url + "/ws").c_str(), loadHandler, conn, NULL);
+    } else {
+        mg_http_connect(&conn->worker->mgr, opts.url.c_str(), loadHandler, conn);
+    }
+}
+
+static void sendNext(struct mg_connection *c, LoadConn *conn) {
+    const Options &opts = *conn->worker->options;
+    conn->path = opts.mix.pick(conn->rng);
+    conn->sentAt = Clock::now();
+    mg_printf(c, "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: dashsrv_loadgen\r\n%s\r\n",
+              opts.mix.entries[conn->path].path.c_str(), conn->worker->host.c_str(),
+              opts.gzip ? "Accept-Encoding: gzip\r\n" : "");
+}
+
+// The topic and version of a delta frame (see include/Server/DeltaFrame.h), so the subscriber can ack it.
+static bool frameVersion(struct mg_str data, std::string &topic, uint64_t &version) {
+    const uint8_t *p = (const uint8_t *)data.buf, *end = p + data.len;
+    if (end - p < 2 || end - p < 2 + p[1])
+        return false;
+
+    topic.assign((const char *)p + 2, p[1]);
+    p += 2 + p[1];
+
+    for (int field = 0; field < 2; ++field) {
+        version = 0;
+        for (int shift = 0; p < end; shift += 7) {
+            uint8_t byte = *p++;
+            version |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                break;
+        }
+    }
+    return true;
+}
+
+static void loadHandler(struct mg_connection *c, int ev, void *ev_data) {
+    LoadConn *conn = (LoadConn *)c->fn_data;
+    Worker &worker = *conn->worker;
+    ThreadStats &stats = worker.stats;
+
+#if MG_TLS != MG_TLS_NONE
+    if (ev == MG_EV_CONNECT && c->is_tls) {
+        // the handshake has to be set up before anything is sent. dashsrv serves a self-signed certificate, so it
+        // isn't verified
+        struct mg_tls_opts tls = {};
+        tls.skip_verification = 1;
+        mg_tls_init(c, &tls);
+    }
+#endif
+
+    if (ev == MG_EV_CONNECT && !conn->websocket) {
+        sendNext(c, conn);
+    } else if (ev == MG_EV_HTTP_MSG && !conn->websocket) {
+        struct mg_http_message *hm = (struct mg_http_message *)ev_data;
+        auto now = Clock::now();
+
+        if (now >= worker.measureFrom && now < worker.measureUntil) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - conn->sentAt);
+            uint64_t micros = (uint64_t)elapsed.count();
+            int status = mg_http_status(hm);
+
+            stats.latency.record(micros);
+            stats.statusClasses[std::clamp(status / 100, 0, 5)]++;
+
+            PathStats &path = stats.paths[conn->path];
+            path.requests++;
+            path.bytes += hm->message.len;
+            path.latency.record(micros);
+        }
+
+        if (worker.running)
+            sendNext(c, conn);
+    } else if (ev == MG_EV_WS_OPEN) {
+        stats.wsOpen++;
+        mg_ws_printf(c, WEBSOCKET_OP_TEXT, "%s", "{\"subscribe\":[\"mc\",\"jellyfin\",\"mesh\",\"local\",\"checks\"]}");
+    } else if (ev == MG_EV_WS_MSG) {
+        struct mg_ws_message *wm = (struct mg_ws_message *)ev_data;
+        auto now = Clock::now();
+        if (now >= worker.measureFrom && now < worker.measureUntil) {
+            stats.wsFrames++;
+            stats.wsBytes += wm->data.len;
+        }
+
+        std::string topic;
+        uint64_t version;
+        if ((wm->flags & 0x0F) == WEBSOCKET_OP_BINARY && frameVersion(wm->data, topic, version)) {
+            std::string ack = "{\"ack\":{\"" + topic + "\":" + std::to_string(version) + "}}";
+            mg_ws_send(c, ack.data(), ack.size(), WEBSOCKET_OP_TEXT);
+        }
+    } else if (ev == MG_EV_ERROR) {
+        if (Clock::now() < worker.measureUntil)
+            stats.errors++;
+    } else if (ev == MG_EV_CLOSE) {
+        if (conn->websocket && c->is_websocket)
+            stats.wsOpen--;
+
+        if (worker.running) {
+            stats.reconnects++;
+            openConnection(conn);
+        }
+    }
+}
+
+static void runWorker(Worker &worker, int httpConns, int wsConns, uint32_t seedBase) {
+    const Options &opts = *worker.options;
+
+    mg_mgr_init(&worker.mgr);
+    worker.stats.paths.resize(opts.mix.entries.size());
+
+    for (int i = 0; i < httpConns + wsConns; ++i) {
+        auto conn = std::make_unique<LoadConn>();
+        conn->worker = &worker;
+        conn->rng.seed(seedBase + (uint32_t)i);
+        conn->websocket = i >= httpConns;
+        openConnection(conn.get());
+        worker.conns.push_back(std::move(conn));
+    }
+
+    while (Clock::now() < worker.measureUntil) {
+        mg_mgr_poll(&worker.mgr, 5);
+    }
+
+    worker.running = false;
+    mg_mgr_free(&worker.mgr);
+}
+
+static int usage(const char *argv0) {
+    std::cerr << "usage: " << argv0
+              << " [--connections n] [--threads n] [--duration s] [--warmup s] [--request path[=weight]]...\n"
+                 "       [--websockets n] [--gzip] [--seed n] [--hdr] [--json] [http://host:port]\n";
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--connections" && hasValue) {
+            opts.connections = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            opts.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--duration" && hasValue) {
+            opts.duration = std::atof(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            opts.warmup = std::atof(argv[++i]);
+        } else if (arg == "--request" && hasValue) {
+            opts.mix.add(argv[++i]);
+        } else if (arg == "--websockets" && hasValue) {
+            opts.websockets = std::atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            opts.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--gzip") {
+            opts.gzip = true;
+        } else if (arg == "--hdr") {
+            opts.hdr = true;
+        } else if (arg == "--json") {
+            opts.json = true;
+        } else if (arg.starts_with("http://") || arg.starts_with("https://")) {
+#if MG_TLS == MG_TLS_NONE
+            if (arg.starts_with("https://")) {
+                std::cerr << "https targets need mongoose built with TLS (MG_TLS)\n";
+                return 1;
+            }
+#endif
+            opts.url = arg;
+            while (opts.url.ends_with("/"))
+                opts.url.pop_back();
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    if (opts.mix.entries.empty()) {
+        // roughly what a dashboard page load and its polling fetch
+        for (const char *spec : { "/=1", "/static/js/dash.js=1", "/static/js/delta.js=1", "/static/css/basic.css=1",
+                                  "/api/local=2", "/api/status=4", "/api/mc=4", "/api/jellyfin=2" })
+            opts.mix.add(spec);
+    }
+
+    if (opts.connections < 1 && opts.websockets < 1)
+        return usage(argv[0]);
+
+    mg_log_set(MG_LL_NONE);
+
+    struct mg_str host = mg_url_host(opts.url.c_str());
+    unsigned short port = mg_url_port(opts.url.c_str());
+
+    auto start = Clock::now();
+    auto measureFrom = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opts.warmup));
+    auto measureUntil =
+        measureFrom + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opts.duration));
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < opts.threads; ++t) {
+        auto worker = std::make_unique<Worker>();
+        worker->options = &opts;
+        worker->host = std::string(host.buf, host.len) + ":" + std::to_string(port);
+        worker->measureFrom = measureFrom;
+        worker->measureUntil = measureUntil;
+        workers.push_back(std::move(worker));
+    }
+
+    for (int t = 0; t < opts.threads; ++t) {
+        // spread connections evenly, the first threads take the remainder
+        int http = opts.connections / opts.threads + (t < opts.connections % opts.threads ? 1 : 0);
+        int ws = opts.websockets / opts.threads + (t < opts.websockets % opts.threads ? 1 : 0);
+        threads.emplace_back(runWorker, std::ref(*workers[t]), http, ws, opts.seed * 100003u + (uint32_t)t * 10007u);
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    ThreadStats total;
+    total.paths.resize(opts.mix.entries.size());
+    for (const auto &worker : workers) {
+        const ThreadStats &s = worker->stats;
+        total.latency.merge(s.latency);
+        for (size_t i = 0; i < s.paths.size(); ++i) {
+            total.paths[i].requests += s.paths[i].requests;
+            total.paths[i].bytes += s.paths[i].bytes;
+            total.paths[i].latency.merge(s.paths[i].latency);
+        }
+        for (size_t i = 0; i < s.statusClasses.size(); ++i)
+            total.statusClasses[i] += s.statusClasses[i];
+        total.errors += s.errors;
+        total.reconnects += s.reconnects;
+        total.wsFrames += s.wsFrames;
+        total.wsBytes += s.wsBytes;
+    }
+
+    uint64_t bytes = 0;
+    for (const auto &path : total.paths)
+        bytes += path.bytes;
+
+    double seconds = opts.duration;
+    double rps = total.latency.count() / seconds;
+
+    if (opts.json) {
+        nlohmann::json out;
+        out["target"] = opts.url;
+        out["connections"] = opts.connections;
+        out["threads"] = opts.threads;
+        out["duration"] = opts.duration;
+        out["seed"] = opts.seed;
+        out["requests"] = total.latency.count();
+        out["requests_per_second"] = rps;
+        out["bytes_per_second"] = bytes / seconds;
+        out["errors"] = total.errors;
+        out["reconnects"] = total.reconnects;
+        for (int i = 1; i < 6; ++i)
+            out["status"][std::to_string(i) + "xx"] = total.statusClasses[i];
+
+        auto latencyJSON = [](const LatencyHistogram &h) {
+            return nlohmann::json{ { "p50_us", h.percentile(50) },   { "p90_us", h.percentile(90) },
+                                   { "p99_us", h.percentile(99) },   { "p999_us", h.percentile(99.9) },
+                                   { "max_us", h.max() },            { "mean_us", h.mean() } };
+        };
+        out["latency"] = latencyJSON(total.latency);
+
+        for (size_t i = 0; i < total.paths.size(); ++i) {
+            nlohmann::json path = latencyJSON(total.paths[i].latency);
+            path["path"] = opts.mix.entries[i].path;
+            path["weight"] = opts.mix.entries[i].weight;
+            path["requests"] = total.paths[i].requests;
+            path["bytes"] = total.paths[i].bytes;
+            out["paths"].push_back(path);
+        }
+
+        out["websockets"] = { { "subscribers", opts.websockets },
+                              { "frames", total.wsFrames },
+                              { "frames_per_second", total.wsFrames / seconds },
+                              { "bytes", total.wsBytes } };
+
+        std::cout << out.dump(2) << "\n";
+        return 0;
+    }
+
+    std::printf("Target %s: %d connections, %d websocket subscribers, %d threads, %.1fs (after %.1fs warmup)\n",
+                opts.url.c_str(), opts.connections, opts.websockets, opts.threads, opts.duration, opts.warmup);
+    std::printf("  Requests:   %llu (%.1f/s), %.2f MB/s\n", (unsigned long long)total.latency.count(), rps,
+                bytes / seconds / 1e6);
+    std::printf("  Status:     2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu\n", (unsigned long long)total.statusClasses[2],
+                (unsigned long long)total.statusClasses[3], (unsigned long long)total.statusClasses[4],
+                (unsigned long long)total.statusClasses[5]);
+    std::printf("  Errors:     %llu, reconnects %llu\n", (unsigned long long)total.errors,
+                (unsigned long long)total.reconnects);
+    std::printf("  Latency:    p50 %.3fms, p90 %.3fms, p99 %.3fms, p99.9 %.3fms, max %.3fms\n",
+                total.latency.percentile(50) / 1000.0, total.latency.percentile(90) / 1000.0,
+                total.latency.percentile(99) / 1000.0, total.latency.percentile(99.9) / 1000.0,
+                total.latency.max() / 1000.0);
+
+    std::printf("\n  %-28s %6s %10s %10s %10s %10s\n", "Path", "Weight", "Requests", "p50(ms)", "p99(ms)",
+                "p99.9(ms)");
+    for (size_t i = 0; i < total.paths.size(); ++i) {
+        const PathStats &p = total.paths[i];
+        std::printf("  %-28s %6u %10llu %10.3f %10.3f %10.3f\n", opts.mix.entries[i].path.c_str(),
+                    opts.mix.entries[i].weight, (unsigned long long)p.requests, p.latency.percentile(50) / 1000.0,
+                    p.latency.percentile(99) / 1000.0, p.latency.percentile(99.9) / 1000.0);
+    }
+
+    if (opts.websockets > 0) {
+        std::printf("\n  Websockets: %d subscribers, %llu frames (%.1f/s), %llu bytes\n", opts.websockets,
+                    (unsigned long long)total.wsFrames, total.wsFrames / seconds, (unsigned long long)total.wsBytes);
+    }
+
+    if (opts.hdr) {
+        std::printf("\n");
+        total.latency.printDistribution(stdout);
+    }
+
+    return 0;
+}
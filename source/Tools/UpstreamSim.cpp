@@ -0,0 +1,642 @@
+// dashsrv_upstreamsim: fake upstreams on localhost, so dashsrv can be scaled and broken without real services.
+//
+//   dashsrv_upstreamsim [options] <endpoint groups...>
+//
+// Endpoint groups, repeatable:
+//   --minecraft <n>[@port]   Server List Ping servers on consecutive ports (default from 30000), each also answers
+//                            Query (GameSpy4) full stats over UDP on the same port
+//   --jellyfin <n>[@port]    Jellyfin /health and /System/Info/Public (default from 40000)
+//   --dashboard <n>[@port]   peer dashsrv /api/local (default from 50000)
+//
+// Faults, each group takes the values in effect where it appears on the command line:
+//   --latency <ms>           delay before every reply (default 0)
+//   --jitter <ms>            plus a uniform random 0..ms on top of the latency (default 0)
+//   --fragment <bytes>       write replies in pieces of this size, each its own write (default 0, whole reply)
+//   --drip <ms>              wait this long between pieces, a slow drip (default 0, implies --fragment 1 if unset)
+//   --refuse <fraction>      share of the group's endpoints that never listen, connecting is refused (default 0)
+//   --timeout <fraction>     share of requests that are read and never answered (default 0)
+//   --healthy                resets all of the above
+//
+// Other options:
+//   --host <ip>              address to listen on (default 127.0.0.1)
+//   --favicon <bytes>        size of the Minecraft favicon, for large status payloads (default 0, none)
+//   --churn <ms>             how often a simulated status changes, players, cpu and memory drift (default 5000)
+//   --seed <n>               seeds which endpoints refuse and which requests time out (default 1)
+//   --config                 print a config.json "servers" array for the endpoints and keep running
+//   --query                  the printed Minecraft servers are polled with "probe": "query"
+//
+// Queries are answered right away, of the faults only --refuse and --timeout apply to them. Challenge tokens expire
+// every 30 seconds like vanilla's, the previous one is still accepted until then.
+//
+// Example, a 1000 peer mesh where a tenth of the peers is down and the rest answer slowly:
+//   dashsrv_upstreamsim --refuse 0.1 --latency 40 --jitter 80 --dashboard 1000 --config
+
+#include <Minecraft/GameSpy.h>
+#include <Minecraft/MCPacket.h>
+#include <Server/Statuses.h>
+
+#include <mongoose.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+enum class Kind { Minecraft, Jellyfin, Dashboard };
+
+static const char *kindName(Kind kind) {
+    switch (kind) {
+    case Kind::Minecraft:
+        return "minecraft";
+    case Kind::Jellyfin:
+        return "jellyfin";
+    case Kind::Dashboard:
+        return "dashboard";
+    }
+    return "";
+}
+
+struct Faults {
+    uint64_t latencyMS = 0;
+    uint64_t jitterMS = 0;
+    size_t fragment = 0;
+    uint64_t dripMS = 0;
+    double refuse = 0;
+    double timeout = 0;
+};
+
+struct Endpoint {
+    Kind kind;
+    uint32_t index; // within its kind, names the endpoint and seeds its status
+    uint16_t port;
+    Faults faults;
+    bool listening;
+};
+
+struct Reply {
+    std::string bytes;
+    Clock::time_point at; // when the next piece may go out
+    bool close;
+};
+
+// Per accepted connection, replaces the listener's Endpoint as fn_data.
+struct Session {
+    Endpoint *endpoint;
+    std::deque<Reply> replies;
+    bool hold = false; // a timed out request, nothing is ever sent again
+    bool handshaken = false;
+};
+
+struct Stats {
+    uint64_t accepted = 0;
+    uint64_t answered = 0;
+    uint64_t held = 0;
+    uint64_t open = 0;
+};
+
+static Stats gStats;
+static std::mt19937_64 gRandom;
+static size_t gFaviconBytes = 0;
+static uint64_t gChurnMS = 5000;
+static volatile sig_atomic_t gStop = 0;
+
+static bool chance(double fraction) {
+    return fraction > 0 && std::uniform_real_distribution<double>(0, 1)(gRandom) < fraction;
+}
+
+// splitmix64, turns (endpoint, churn period) into stable pseudo random status values
+static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t churnPeriod() {
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    return gChurnMS == 0 ? 0 : (uint64_t)now / gChurnMS;
+}
+
+static void queueReply(Session &session, std::string bytes, bool close) {
+    if (session.hold)
+        return;
+
+    const Faults &faults = session.endpoint->faults;
+    if (chance(faults.timeout)) {
+        session.hold = true;
+        ++gStats.held;
+        return;
+    }
+
+    uint64_t delay = faults.latencyMS;
+    if (faults.jitterMS > 0)
+        delay += std::uniform_int_distribution<uint64_t>(0, faults.jitterMS)(gRandom);
+
+    // replies leave in the order they were asked for, whatever their own delay
+    Clock::time_point at = Clock::now() + std::chrono::milliseconds(delay);
+    if (!session.replies.empty())
+        at = std::max(at, session.replies.back().at);
+
+    session.replies.push_back({ std::move(bytes), at, close });
+}
+
+// Sends whatever is due, a piece at a time when the endpoint fragments. Returns true while replies are waiting.
+static bool flush(struct mg_connection *c, Session &session) {
+    const Faults &faults = session.endpoint->faults;
+    Clock::time_point now = Clock::now();
+
+    while (!session.replies.empty() && !session.hold) {
+        Reply &reply = session.replies.front();
+        if (reply.at > now)
+            return true;
+
+        size_t piece = faults.fragment > 0 ? faults.fragment : (faults.dripMS > 0 ? 1 : reply.bytes.size());
+        piece = std::min(piece, reply.bytes.size());
+        mg_send(c, reply.bytes.data(), piece);
+        reply.bytes.erase(0, piece);
+
+        if (!reply.bytes.empty()) {
+            // the rest goes in a later poll iteration, so every piece is its own write
+            reply.at = now + std::chrono::milliseconds(faults.dripMS);
+            return true;
+        }
+
+        ++gStats.answered;
+        if (reply.close)
+            c->is_draining = 1;
+        session.replies.pop_front();
+        c->is_resp = 0; // lets mongoose parse the next pipelined request
+    }
+
+    return false;
+}
+
+static std::string httpResponse(int status, const char *reason, const std::string &contentType,
+                                const std::string &body, const std::string &extraHeaders, bool close) {
+    std::string out = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    if (!contentType.empty())
+        out += "Content-Type: " + contentType + "\r\n";
+    out += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    out += extraHeaders;
+    if (close)
+        out += "Connection: close\r\n";
+    out += "\r\n";
+    out += body;
+    return out;
+}
+
+static std::string jellyfinInfo(const Endpoint &endpoint, const std::string &host) {
+    char id[33];
+    std::snprintf(id, sizeof(id), "%016llx%016llx", (unsigned long long)mix(endpoint.index),
+                  (unsigned long long)mix(endpoint.index + 1));
+
+    nlohmann::json json;
+    json["LocalAddress"] = "http://" + host + ":" + std::to_string(endpoint.port);
+    json["ServerName"] = "sim-jellyfin-" + std::to_string(endpoint.index);
+    json["Version"] = "10.10.7";
+    json["ProductName"] = "Jellyfin Server";
+    json["OperatingSystem"] = "Linux";
+    json["Id"] = id;
+    json["StartupWizardCompleted"] = true;
+    return json.dump();
+}
+
+static DashboardStatus peerStatus(const Endpoint &endpoint, uint64_t period) {
+    uint64_t seed = mix(((uint64_t)endpoint.index << 32) ^ period);
+
+    DashboardStatus status;
+    status.IPs = { "10." + std::to_string((endpoint.index >> 16) & 0xff) + "." +
+                   std::to_string((endpoint.index >> 8) & 0xff) + "." + std::to_string(endpoint.index & 0xff) };
+    status.Memory.Total = 16003;
+    status.Memory.Available = 2000 + seed % 12000;
+    status.CPU = (double)(seed >> 16 & 0xffff) / 655.35;
+    status.Ping = 0;
+    status.IsCurrent = false;
+    status.Online = true;
+    return status;
+}
+
+static void handleHttp(struct mg_connection *c, Session &session, struct mg_http_message *hm, const std::string &host) {
+    const Endpoint &endpoint = *session.endpoint;
+    struct mg_str *connection = mg_http_get_header(hm, "Connection");
+    bool close = connection != nullptr && mg_strcasecmp(*connection, mg_str("close")) == 0;
+
+    std::string reply;
+    if (endpoint.kind == Kind::Jellyfin && mg_match(hm->uri, mg_str("/health"), nullptr)) {
+        reply = httpResponse(200, "OK", "text/plain", "Healthy", "", close);
+    } else if (endpoint.kind == Kind::Jellyfin && mg_match(hm->uri, mg_str("/System/Info/Public"), nullptr)) {
+        reply = httpResponse(200, "OK", "application/json", jellyfinInfo(endpoint, host), "", close);
+    } else if (endpoint.kind == Kind::Dashboard && mg_match(hm->uri, mg_str("/api/local"), nullptr)) {
+        // the status only changes once per churn period, within one the ETag holds and revalidation gets a 304
+        uint64_t period = churnPeriod();
+        std::string etag = "\"" + std::to_string(endpoint.index) + "-" + std::to_string(period) + "\"";
+        std::string headers = "ETag: " + etag + "\r\nCache-Control: no-cache\r\n";
+
+        struct mg_str *inm = mg_http_get_header(hm, "If-None-Match");
+        if (inm != nullptr && mg_strcmp(*inm, mg_str(etag.c_str())) == 0) {
+            reply = httpResponse(304, "Not Modified", "", "", headers, close);
+        } else {
+            reply = httpResponse(200, "OK", "application/json",
+                                 DashboardStatusToJSON(peerStatus(endpoint, period), gChurnMS), headers, close);
+        }
+    } else {
+        reply = httpResponse(404, "Not Found", "text/plain", "Not Found", "", close);
+    }
+
+    queueReply(session, std::move(reply), close);
+    flush(c, session); // without delays the reply goes out right away, and is_resp is cleared again
+}
+
+static uint64_t minecraftOnline(const Endpoint &endpoint) {
+    return mix(((uint64_t)endpoint.index << 32) ^ churnPeriod()) % 21;
+}
+
+static std::string minecraftPlayer(const Endpoint &endpoint, uint64_t n) {
+    return "Sim" + std::to_string(endpoint.index) + "_" + std::to_string(n);
+}
+
+static std::string minecraftStatus(const Endpoint &endpoint) {
+    uint64_t online = minecraftOnline(endpoint);
+
+    // like vanilla, the sample has at most 12 of the players
+    nlohmann::json sample = nlohmann::json::array();
+    for (uint64_t n = 0; n < std::min<uint64_t>(online, 12); ++n)
+        sample.push_back(
+            { { "name", minecraftPlayer(endpoint, n) }, { "id", "00000000-0000-0000-0000-000000000000" } });
+
+    nlohmann::json json;
+    json["version"] = { { "name", "1.21.11" }, { "protocol", 774 } };
+    json["description"] = "§aSimulated §lserver§r §7#" + std::to_string(endpoint.index);
+    json["players"] = { { "max", 20 }, { "online", online }, { "sample", sample } };
+    json["enforcesSecureChat"] = true;
+    if (gFaviconBytes > 0)
+        json["favicon"] = "data:image/png;base64," + std::string(gFaviconBytes, 'A');
+    std::string text = json.dump();
+
+    using namespace Minecraft::packetool;
+    std::vector<uint8_t> packet;
+    packet.push_back(MC_PACKETACC_STATUS);
+    WriteVarInt(packet, (int32_t)text.size());
+    packet.insert(packet.end(), text.begin(), text.end());
+    WriteVarInt(packet, packet.begin(), (int32_t)packet.size());
+    return std::string(packet.begin(), packet.end());
+}
+
+// Reads as many whole packets as arrived: handshake, status request, ping. The pong closes the connection, which is
+// what QueryMinecraft waits for.
+static void handleMinecraft(struct mg_connection *c, Session &session) {
+    const uint8_t *buf = c->recv.buf;
+    size_t len = c->recv.len, used = 0;
+
+    if (!session.handshaken && len > 0 && buf[0] == MC_PACKET_HANDSHAKE_LEGACY) {
+        c->is_closing = 1;
+        return;
+    }
+
+    while (used < len) {
+        int32_t length = 0;
+        int n = Minecraft::packetool::TryReadVarInt(buf + used, len - used, length);
+        if (n < 0 || (n > 0 && (length <= 0 || length > 32767))) {
+            c->is_closing = 1;
+            return;
+        }
+        if (n == 0 || len - used - n < (size_t)length)
+            break;
+
+        const uint8_t *packet = buf + used + n;
+        uint8_t id = packet[0];
+        used += n + length;
+
+        if (!session.handshaken) {
+            if (id != MC_PACKET_HANDSHAKE || packet[length - 1] != MC_HANDSHAKE_INTENT_STATUS) {
+                c->is_closing = 1;
+                return;
+            }
+            session.handshaken = true;
+        } else if (id == MC_PACKETID_STATUS) {
+            queueReply(session, minecraftStatus(*session.endpoint), false);
+        } else if (id == MC_PACKETID_PING && length == 9) {
+            std::string pong(reinterpret_cast<const char *>(packet) - 1, 10); // length prefix, id and payload
+            pong[0] = 9;
+            pong[1] = MC_PACKETACC_PONG;
+            queueReply(session, std::move(pong), true);
+        } else {
+            c->is_closing = 1;
+            return;
+        }
+    }
+
+    mg_iobuf_del(&c->recv, 0, used);
+}
+
+// Tokens are tied to the asking address and the 30 second window they were handed out in.
+static int32_t queryToken(const struct mg_connection *c, uint64_t window) {
+    uint64_t addr = c->rem.addr.ip6[0] ^ c->rem.addr.ip6[1];
+    return (int32_t)(mix(mix(addr) ^ c->rem.port ^ (window << 16)) & 0x7FFFFFFF);
+}
+
+// Answers handshakes and full stats on a Minecraft endpoint's UDP port, every read is one datagram.
+static void query_ev_handler(struct mg_connection *c, int ev, __attribute__((unused)) void *ev_data) {
+    if (ev != MG_EV_READ)
+        return;
+
+    using namespace Minecraft::packetool;
+    const Endpoint &endpoint = *static_cast<Endpoint *>(c->fn_data);
+    const uint8_t *buf = c->recv.buf;
+    size_t len = c->recv.len;
+    c->recv.len = 0;
+
+    if (len < 7 || (uint16_t)ReadShort(buf) != GS_MAGIC)
+        return;
+    ++gStats.accepted;
+    if (chance(endpoint.faults.timeout)) {
+        ++gStats.held;
+        return;
+    }
+
+    uint8_t type = buf[2];
+    uint64_t window = (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(Clock::now().time_since_epoch())
+                          .count() / 30;
+
+    std::vector<uint8_t> reply;
+    reply.push_back(type);
+    reply.insert(reply.end(), buf + 3, buf + 7); // session id
+    auto text = [&](const std::string &value) {
+        reply.insert(reply.end(), value.c_str(), value.c_str() + value.size() + 1); // with the terminator
+    };
+
+    if (type == GS_PACKET_HANDSHAKE && len == 7) {
+        text(std::to_string(queryToken(c, window)));
+    } else if (type == GS_PACKET_STAT && len == 15) {
+        int32_t token = ReadInt(buf + 7);
+        if (token != queryToken(c, window) && token != queryToken(c, window - 1))
+            return;
+
+        uint64_t online = minecraftOnline(endpoint);
+        text("splitnum");
+        reply.push_back(0x80);
+        reply.push_back(0x00);
+        const std::pair<std::string, std::string> values[] = {
+            { "hostname", "§aSimulated §lserver§r §7#" + std::to_string(endpoint.index) },
+            { "gametype", "SMP" },
+            { "game_id", "MINECRAFT" },
+            { "version", "1.21.11" },
+            { "plugins", "" },
+            { "map", "world" },
+            { "numplayers", std::to_string(online) },
+            { "maxplayers", "20" },
+            { "hostport", std::to_string(endpoint.port) },
+            { "hostip", "127.0.0.1" },
+        };
+        for (const auto &[key, value] : values) {
+            text(key);
+            text(value);
+        }
+        reply.push_back(0x00);
+        text("\x01player_");
+        reply.push_back(0x00);
+        for (uint64_t n = 0; n < online; ++n)
+            text(minecraftPlayer(endpoint, n));
+        reply.push_back(0x00);
+    } else {
+        return;
+    }
+
+    mg_send(c, reply.data(), reply.size());
+    ++gStats.answered;
+}
+
+static void ev_handler(struct mg_connection *c, int ev, void *ev_data) {
+    if (c->is_listening)
+        return;
+
+    if (ev == MG_EV_ACCEPT) {
+        Session *session = new Session();
+        session->endpoint = static_cast<Endpoint *>(c->fn_data);
+        c->fn_data = session;
+        c->data[0] = 1;
+        ++gStats.accepted;
+        ++gStats.open;
+        return;
+    }
+
+    // events before the accept still carry the listener's Endpoint
+    if (c->data[0] == 0)
+        return;
+
+    Session *session = static_cast<Session *>(c->fn_data);
+    switch (ev) {
+    case MG_EV_READ:
+        if (session->endpoint->kind == Kind::Minecraft)
+            handleMinecraft(c, *session);
+        break;
+    case MG_EV_HTTP_MSG: {
+        const std::string *host = static_cast<const std::string *>(c->mgr->userdata);
+        handleHttp(c, *session, static_cast<struct mg_http_message *>(ev_data), *host);
+        break;
+    }
+    case MG_EV_POLL:
+        flush(c, *session);
+        break;
+    case MG_EV_CLOSE:
+        --gStats.open;
+        delete session;
+        break;
+    }
+}
+
+static void onSignal(int) { gStop = 1; }
+
+static void raiseFileLimit() {
+#ifndef _WIN32
+    // every endpoint is a listening socket, thousands of them go well past the usual soft limit of 1024
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+static void usage(const char *argv0) {
+    std::cerr << "usage: " << argv0
+              << " [--latency <ms>] [--jitter <ms>] [--fragment <bytes>] [--drip <ms>] [--refuse <fraction>]\n"
+                 "       [--timeout <fraction>] [--healthy] [--host <ip>] [--favicon <bytes>] [--churn <ms>]\n"
+                 "       [--seed <n>] [--config] [--query] (--minecraft|--jellyfin|--dashboard <n>[@port])...\n";
+}
+
+int main(int argc, char **argv) {
+    std::string host = "127.0.0.1";
+    uint64_t seed = 1;
+    bool printConfig = false;
+    bool printQuery = false;
+
+    struct Group {
+        Kind kind;
+        uint32_t count;
+        int port; // -1 continues after the previous group of the same kind
+        Faults faults;
+    };
+    std::vector<Group> groups;
+    Faults faults;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--healthy") {
+            faults = Faults{};
+        } else if (arg == "--config") {
+            printConfig = true;
+        } else if (arg == "--query") {
+            printQuery = true;
+        } else if (!hasValue) {
+            usage(argv[0]);
+            return 1;
+        } else if (arg == "--minecraft" || arg == "--jellyfin" || arg == "--dashboard") {
+            Kind kind = arg == "--minecraft" ? Kind::Minecraft : arg == "--jellyfin" ? Kind::Jellyfin : Kind::Dashboard;
+            std::string spec = argv[++i];
+            size_t at = spec.find('@');
+            int port = at == std::string::npos ? -1 : std::atoi(spec.c_str() + at + 1);
+            groups.push_back({ kind, (uint32_t)std::strtoul(spec.c_str(), nullptr, 10), port, faults });
+        } else if (arg == "--latency") {
+            faults.latencyMS = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--jitter") {
+            faults.jitterMS = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--fragment") {
+            faults.fragment = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--drip") {
+            faults.dripMS = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--refuse") {
+            faults.refuse = std::atof(argv[++i]);
+        } else if (arg == "--timeout") {
+            faults.timeout = std::atof(argv[++i]);
+        } else if (arg == "--host") {
+            host = argv[++i];
+        } else if (arg == "--favicon") {
+            gFaviconBytes = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--churn") {
+            gChurnMS = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed") {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (groups.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    gRandom.seed(seed);
+    raiseFileLimit();
+    mg_log_set(MG_LL_ERROR);
+
+    struct mg_mgr mgr;
+    mg_mgr_init(&mgr);
+    mgr.userdata = &host;
+
+    // endpoints never move once listening, the listeners point into this
+    size_t total = 0;
+    for (const auto &group : groups)
+        total += group.count;
+    std::vector<Endpoint> endpoints;
+    endpoints.reserve(total);
+
+    int nextPort[3] = { 30000, 40000, 50000 };
+    uint32_t nextIndex[3] = { 0, 0, 0 };
+    size_t listening = 0;
+
+    for (const auto &group : groups) {
+        int k = (int)group.kind;
+        if (group.port >= 0)
+            nextPort[k] = group.port;
+
+        for (uint32_t n = 0; n < group.count; ++n) {
+            if (nextPort[k] > 65535) {
+                std::cerr << "Ran out of ports for the " << kindName(group.kind) << " endpoints\n";
+                mg_mgr_free(&mgr);
+                return 1;
+            }
+
+            Endpoint &endpoint =
+                endpoints.emplace_back(Endpoint{ group.kind, nextIndex[k]++, (uint16_t)nextPort[k]++, group.faults,
+                                                 false });
+            if (chance(group.faults.refuse))
+                continue;
+
+            std::string url = (group.kind == Kind::Minecraft ? "tcp://" : "http://") + host + ":" +
+                              std::to_string(endpoint.port);
+            struct mg_connection *c = group.kind == Kind::Minecraft
+                                          ? mg_listen(&mgr, url.c_str(), ev_handler, &endpoint)
+                                          : mg_http_listen(&mgr, url.c_str(), ev_handler, &endpoint);
+            if (c != nullptr && group.kind == Kind::Minecraft) {
+                url = "udp://" + host + ":" + std::to_string(endpoint.port);
+                c = mg_listen(&mgr, url.c_str(), query_ev_handler, &endpoint);
+            }
+            if (c == nullptr) {
+                std::cerr << "Failed to listen on " << url << "\n";
+                mg_mgr_free(&mgr);
+                return 1;
+            }
+
+            endpoint.listening = true;
+            ++listening;
+        }
+    }
+
+    if (printConfig) {
+        nlohmann::json servers = nlohmann::json::array();
+        for (const auto &endpoint : endpoints) {
+            nlohmann::json server = { { "type", kindName(endpoint.kind) }, { "ip", host }, { "port", endpoint.port } };
+            if (endpoint.kind == Kind::Minecraft)
+                server["version"] = 774;
+            if (endpoint.kind == Kind::Minecraft && printQuery)
+                server["probe"] = "query";
+            servers.push_back(server);
+        }
+        std::cout << servers.dump(2) << "\n" << std::flush;
+    }
+
+    std::cerr << "Simulating " << endpoints.size() << " endpoints on " << host << ", " << listening
+              << " listening, " << endpoints.size() - listening << " refusing\n";
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    Clock::time_point lastReport = Clock::now();
+    Stats reported;
+    while (!gStop) {
+        // replies wait on a timer, so the loop has to come around often for the delays to be accurate
+        mg_mgr_poll(&mgr, 1);
+
+        if (Clock::now() - lastReport >= std::chrono::seconds(5)) {
+            lastReport = Clock::now();
+            if (gStats.accepted != reported.accepted || gStats.answered != reported.answered) {
+                std::cerr << "accepted " << gStats.accepted << ", answered " << gStats.answered << ", timed out "
+                          << gStats.held << ", open " << gStats.open << "\n";
+                reported = gStats;
+            }
+        }
+    }
+
+    mg_mgr_free(&mgr);
+    return 0;
+}